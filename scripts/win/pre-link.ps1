@@ -51,6 +51,12 @@ glslc -fshader-stage=vert pp_vert.glsl -o pp_vert.spv
 if(-not $?){ end }
 glslc -fshader-stage=frag pp_frag.glsl -o pp_frag.spv
 if(-not $?){ end }
+glslc -fshader-stage=frag yuv_frag.glsl -o yuv_frag.spv
+if(-not $?){ end }
+glslc -fshader-stage=frag yuv_encode_frag.glsl -o yuv_encode_frag.spv
+if(-not $?){ end }
+glslc -fshader-stage=frag mix_frag.glsl -o mix_frag.spv
+if(-not $?){ end }
 log "Shaders compiled"
 
 # copy resources
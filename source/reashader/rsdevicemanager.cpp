@@ -0,0 +1,102 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#include "rsdevicemanager.h"
+
+namespace ReaShader
+{
+	std::mutex DeviceManager::mutex;
+
+	VkInstance DeviceManager::instance{ VK_NULL_HANDLE };
+	uint32_t DeviceManager::instanceRefs{ 0 };
+	vkt::deletion_queue DeviceManager::instanceDeletionQueue;
+
+	std::vector<DeviceManager::SharedDevice*> DeviceManager::devices;
+
+	VkInstance DeviceManager::acquireInstance()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (!instanceRefs++)
+			instance = vkt::createVkInstance(instanceDeletionQueue, "ReaShader Effect", "No Engine");
+
+		return instance;
+	}
+
+	void DeviceManager::releaseInstance()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (!--instanceRefs)
+		{
+			instanceDeletionQueue.flush();
+			instance = VK_NULL_HANDLE;
+		}
+	}
+
+	DeviceManager::SharedDevice* DeviceManager::acquireDevice(VkPhysicalDevice physicalDevice)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto found = std::find_if(devices.begin(), devices.end(),
+								  [&](SharedDevice* device) { return device->key == physicalDevice; });
+		if (found != devices.end())
+		{
+			(*found)->refs++;
+			return *found;
+		}
+
+		SharedDevice* sharedDevice = new SharedDevice{ physicalDevice, 1 };
+
+		sharedDevice->physicalDevice =
+			new vkt::Physical::Device(sharedDevice->deletionQueue, instance, physicalDevice);
+
+		// optional extensions for the zero copy frame paths, enabled only if supported
+
+		std::vector<const char*> deviceExtensions;
+
+		if (sharedDevice->physicalDevice->minImportedHostPointerAlignment > 0)
+			deviceExtensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+		if (sharedDevice->physicalDevice->supportsHostImageCopy(VK_FORMAT_B8G8R8A8_UNORM))
+			deviceExtensions.push_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME);
+
+		// indirect draws of the scene, many per call and their count written by the gpu, also enabled only if
+		// supported (the renderer falls back to one call per draw)
+
+		VkPhysicalDeviceFeatures enabledFeatures{};
+		enabledFeatures.multiDrawIndirect = sharedDevice->physicalDevice->deviceFeatures.multiDrawIndirect;
+
+		if (sharedDevice->physicalDevice->extensionSupported(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+			deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+		sharedDevice->device = new vkt::Logical::Device(sharedDevice->deletionQueue, sharedDevice->physicalDevice,
+														enabledFeatures, deviceExtensions);
+
+		devices.push_back(sharedDevice);
+
+		return sharedDevice;
+	}
+
+	void DeviceManager::releaseDevice(SharedDevice* sharedDevice)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (--sharedDevice->refs)
+			return;
+
+		// no other user left, nothing else submits
+		sharedDevice->device->waitIdle();
+
+		sharedDevice->meshes.clear();
+		sharedDevice->textures.clear();
+		sharedDevice->deletionQueue.flush();
+
+		devices.erase(std::find(devices.begin(), devices.end(), sharedDevice));
+		delete sharedDevice;
+	}
+} // namespace ReaShader
@@ -0,0 +1,71 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#pragma once
+
+#include "vkt/vktcommon.h"
+#include "vkt/vktdevices.h"
+#include "vkt/vktimages.h"
+#include "vkt/vktrendering.h"
+
+#include <mutex>
+
+namespace ReaShader
+{
+	/**
+	 * @brief Process wide vulkan instance and devices, shared by all the plugin instances.
+	 * Devices are refcounted and keyed by physical device. Every renderer works through its own handle to the shared
+	 * device (own command pools and deletion queue), submissions from all of them go through the same batched queues.
+	 */
+	class DeviceManager
+	{
+	  public:
+		struct SharedDevice
+		{
+			VkPhysicalDevice key;
+			uint32_t refs;
+
+			// destroys the device and everything created through it
+			vkt::deletion_queue deletionQueue;
+
+			vkt::Physical::Device* physicalDevice;
+			vkt::Logical::Device* device;
+
+			// immutable resources every renderer uses, created once through the device (lock resourcesMutex)
+			std::mutex resourcesMutex;
+			VkSampler sampler;
+			vkt::vectors::searchable_map<int, vkt::Rendering::Mesh*> meshes;
+			vkt::vectors::searchable_map<int, vkt::Images::AllocatedImage*> textures;
+		};
+
+		/**
+		 * @brief The instance is created by the first call, destroyed by the last release
+		 */
+		static VkInstance acquireInstance();
+		static void releaseInstance();
+
+		/**
+		 * @brief The device of physicalDevice (of the shared instance), created by the first call with the optional
+		 * extensions of the frame paths it supports
+		 */
+		static SharedDevice* acquireDevice(VkPhysicalDevice physicalDevice);
+		/**
+		 * @brief The last release waits for the device and destroys it, the caller must not have work in flight
+		 */
+		static void releaseDevice(SharedDevice* sharedDevice);
+
+	  private:
+		static std::mutex mutex;
+
+		static VkInstance instance;
+		static uint32_t instanceRefs;
+		static vkt::deletion_queue instanceDeletionQueue;
+
+		static std::vector<SharedDevice*> devices;
+	};
+} // namespace ReaShader
@@ -0,0 +1,175 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#include "rsdirtytiles.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RS_DIRTYTILES_SSE2
+#endif
+
+namespace ReaShader
+{
+	// a tile row is at most 64 pixels = 256 bytes = 16 blocks of 16 bytes, one key (2 lanes) per block
+	static constexpr size_t tileRowBytes = DirtyTileTracker::tileSize * 4;
+
+	alignas(16) static const uint64_t blockKeys[32] = {
+		0xbe4ba423396cfeb8, 0x1cad21f72c81017c, 0xdb979083e96dd4de, 0x1f67b3b7a4a44072, 0x78e5c0cc4ee679cb,
+		0x2172ffcc7dd05a82, 0x8e2443f7744608b8, 0x4c263a81e69035e0, 0xcb00c391bb52283c, 0xa32e531b8b65d088,
+		0x4ef90da297486471, 0xd8acdea946ef1938, 0x3f349ce33f76faa8, 0x1d4f0bc7c7bbdcf9, 0x3159b4cd4be0518a,
+		0x647378d9c97e9fc8, 0xc3ebd33483acc5ea, 0xeb6313faffa081c5, 0x49daf0b751dd0d17, 0x9e68d429265516d3,
+		0xfca1477d58be162b, 0xce31d07ad1b8f88f, 0x280416958f3acb45, 0x7e404bbbcafbd7af, 0xc0a5d57f23a7bd73,
+		0x9dbe5f8a3ba3e9f3, 0xa2d5f3f0c4e0a6bb, 0x5f9e8c1d7a3b2e41, 0x1b873593cc9e2d51, 0x85ebca6bc2b2ae35,
+		0x27d4eb2f165667c5, 0x94d049bb133111eb
+	};
+
+	static inline uint64_t mix64(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccd;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53;
+		h ^= h >> 33;
+		return h;
+	}
+
+	// acc[lane] += data[other lane] + lo32(data ^ key) * hi32(data ^ key), same math as the sse2 path
+	static inline void accumulateScalar(uint64_t acc[2], const uint8_t* block, const uint64_t* key)
+	{
+		uint64_t data[2];
+		memcpy(data, block, sizeof(data));
+
+		for (int lane = 0; lane < 2; lane++)
+		{
+			uint64_t dataKey = data[lane] ^ key[lane];
+			acc[lane] += data[lane ^ 1] + (dataKey & 0xffffffff) * (dataKey >> 32);
+		}
+	}
+
+	// hash of one row of a tile (rowBytes <= 256)
+	static inline void hashRow(uint64_t acc[2], const uint8_t* row, size_t rowBytes)
+	{
+		size_t blocks = rowBytes / 16;
+		size_t tail = rowBytes % 16;
+
+#ifdef RS_DIRTYTILES_SSE2
+		__m128i accVec = _mm_loadu_si128((const __m128i*)acc);
+
+		for (size_t i = 0; i < blocks; i++)
+		{
+			__m128i dataVec = _mm_loadu_si128((const __m128i*)(row + i * 16));
+			__m128i keyVec = _mm_load_si128((const __m128i*)(blockKeys + i * 2));
+
+			__m128i dataKey = _mm_xor_si128(dataVec, keyVec);
+			__m128i dataKeyHi = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+			__m128i product = _mm_mul_epu32(dataKey, dataKeyHi);
+			__m128i swapped = _mm_shuffle_epi32(dataVec, _MM_SHUFFLE(1, 0, 3, 2));
+
+			accVec = _mm_add_epi64(accVec, _mm_add_epi64(product, swapped));
+		}
+
+		_mm_storeu_si128((__m128i*)acc, accVec);
+#else
+		for (size_t i = 0; i < blocks; i++)
+			accumulateScalar(acc, row + i * 16, blockKeys + i * 2);
+#endif
+
+		if (tail)
+		{
+			uint8_t last[16] = {};
+			memcpy(last, row + blocks * 16, tail);
+			accumulateScalar(acc, last, blockKeys + blocks * 2);
+		}
+	}
+
+	uint64_t hashRows(const void* first, size_t rowBytes, uint32_t rows, size_t rowspan, uint64_t seed)
+	{
+		uint64_t hash = mix64(seed ^ rowBytes ^ ((uint64_t)rows << 32));
+
+		for (uint32_t y = 0; y < rows; y++)
+		{
+			const uint8_t* row = (const uint8_t*)first + y * rowspan;
+
+			// rows longer than a tile are hashed in tile row chunks
+			for (size_t chunk = 0; chunk < rowBytes; chunk += tileRowBytes)
+			{
+				uint64_t acc[2] = { 0x9e3779b97f4a7c15, 0x165667b19e3779f9 };
+				hashRow(acc, row + chunk, std::min(tileRowBytes, rowBytes - chunk));
+
+				// chunks are folded in order, so moving rows around changes the hash
+				hash = mix64(hash ^ acc[0]) + (acc[1] << 29 | acc[1] >> 35);
+			}
+		}
+
+		return mix64(hash);
+	}
+
+	bool DirtyTileTracker::update(const void* bits, uint32_t w, uint32_t h, uint32_t rowspan)
+	{
+		bool comparable = valid && w == frameW && h == frameH && rowspan == frameRowspan;
+
+		uint32_t tilesX = (w + tileSize - 1) / tileSize;
+		uint32_t tilesY = (h + tileSize - 1) / tileSize;
+
+		if (!comparable)
+			hashes.assign((size_t)tilesX * tilesY, 0);
+
+		dirtyRects.clear();
+		uint32_t changedTiles = 0;
+
+		const uint8_t* frame = (const uint8_t*)bits;
+
+		for (uint32_t ty = 0; ty < tilesY; ty++)
+		{
+			uint32_t y = ty * tileSize;
+			uint32_t rows = std::min(tileSize, h - y);
+
+			bool extendLast = false;
+
+			for (uint32_t tx = 0; tx < tilesX; tx++)
+			{
+				uint32_t x = tx * tileSize;
+				uint32_t columns = std::min(tileSize, w - x);
+
+				uint64_t hash = hashRows(frame + (size_t)y * rowspan + (size_t)x * 4, (size_t)columns * 4, rows, rowspan);
+
+				uint64_t& previous = hashes[(size_t)ty * tilesX + tx];
+				bool dirty = !comparable || hash != previous;
+				previous = hash;
+
+				if (!dirty)
+				{
+					extendLast = false;
+					continue;
+				}
+
+				changedTiles++;
+
+				// merge with the changed tile on the left
+				if (extendLast)
+					dirtyRects.back().width += columns;
+				else
+					dirtyRects.push_back({ x, y, columns, rows });
+
+				extendLast = true;
+			}
+		}
+
+		frameW = w;
+		frameH = h;
+		frameRowspan = rowspan;
+		valid = true;
+
+		changedTileRatio = tilesX * tilesY != 0 ? (float)changedTiles / (float)(tilesX * tilesY) : 0.f;
+
+		return comparable;
+	}
+} // namespace ReaShader
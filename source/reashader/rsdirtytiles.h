@@ -0,0 +1,73 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ReaShader
+{
+	/**
+	 * @brief Hash of rows of bytes (rowspan apart), SIMD when available. Used for the dirty tiles and to identify frames.
+	 */
+	uint64_t hashRows(const void* first, size_t rowBytes, uint32_t rows, size_t rowspan, uint64_t seed = 0);
+
+	/**
+	 * @brief Finds the tiles of an rgba frame that changed since the previous frame, by comparing tile hashes.
+	 * Used to upload only the changed parts of mostly static footage.
+	 */
+	class DirtyTileTracker
+	{
+	  public:
+		static constexpr uint32_t tileSize = 64;
+
+		// pixel rect, changed tiles of the same row are merged
+		struct Rect
+		{
+			uint32_t x, y, width, height;
+		};
+
+		/**
+		 * @brief Hashes the tiles of the frame and compares them with the previous frame ones.
+		 * @return false if there was nothing to compare with (first frame, size change, invalidate()), in that case
+		 * every tile is dirty and the previous contents must not be relied upon
+		 */
+		bool update(const void* bits, uint32_t w, uint32_t h, uint32_t rowspan);
+
+		/**
+		 * @brief Forget the previous frame, e.g. when the image the tiles are uploaded to was written by something else
+		 */
+		void invalidate()
+		{
+			valid = false;
+			changedTileRatio = 1.f;
+		}
+
+		const std::vector<Rect>& getDirtyRects()
+		{
+			return dirtyRects;
+		}
+
+		// changed tiles / tiles of the last update, 1 after invalidate()
+		float getChangedTileRatio()
+		{
+			return changedTileRatio;
+		}
+
+	  private:
+		std::vector<uint64_t> hashes;
+		std::vector<Rect> dirtyRects;
+
+		uint32_t frameW{ 0 }, frameH{ 0 }, frameRowspan{ 0 };
+		bool valid{ false };
+
+		float changedTileRatio{ 1.f };
+	};
+} // namespace ReaShader
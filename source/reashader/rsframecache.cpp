@@ -0,0 +1,265 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#include "rsframecache.h"
+#include "rsframecopy.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace ReaShader
+{
+	// compressed tokens: a header with the run length, literal runs are followed by their pixels
+	static constexpr uint32_t literalRunFlag = 0x80000000;
+	static constexpr uint32_t maxRun = 0x7fffffff;
+
+	std::atomic<size_t> RenderedFrameCache::budget{ 1ull << 30 };
+	std::atomic<size_t> RenderedFrameCache::compressedBytesBudget{ 256ull << 20 };
+	std::atomic<size_t> RenderedFrameCache::caches{ 0 };
+
+	RenderedFrameCache::RenderedFrameCache()
+	{
+		caches++;
+	}
+
+	RenderedFrameCache::~RenderedFrameCache()
+	{
+		caches--;
+	}
+
+	size_t RenderedFrameCache::KeyHash::operator()(const Key& key) const
+	{
+		uint64_t projectTimeBits;
+		memcpy(&projectTimeBits, &key.projectTime, sizeof(projectTimeBits));
+
+		uint64_t hash = key.inputHash;
+		hash = hash * 0x9e3779b97f4a7c15 ^ projectTimeBits;
+		hash = hash * 0x9e3779b97f4a7c15 ^ key.paramsHash;
+		hash = hash * 0x9e3779b97f4a7c15 ^ ((uint64_t)(uint32_t)key.w << 32 | (uint32_t)key.h);
+
+		return (size_t)(hash ^ hash >> 32);
+	}
+
+	void RenderedFrameCache::Tier::insert(Entry&& entry)
+	{
+		bytes += entry.pixels.size() * sizeof(uint32_t);
+		entries.push_front(std::move(entry));
+		index[entries.front().key] = entries.begin();
+	}
+
+	void RenderedFrameCache::Tier::erase(std::unordered_map<Key, std::list<Entry>::iterator, KeyHash>::iterator found)
+	{
+		bytes -= found->second->pixels.size() * sizeof(uint32_t);
+		entries.erase(found->second);
+		index.erase(found);
+	}
+
+	void RenderedFrameCache::Tier::clear()
+	{
+		entries.clear();
+		index.clear();
+		bytes = 0;
+	}
+
+	void RenderedFrameCache::setBudget(size_t bytes, size_t compressedBytes)
+	{
+		budget = bytes;
+		compressedBytesBudget = compressedBytes;
+	}
+
+	size_t RenderedFrameCache::hotBudget()
+	{
+		return budget / std::max<size_t>(caches, 1);
+	}
+
+	size_t RenderedFrameCache::compressedBudget()
+	{
+		return compressedBytesBudget / std::max<size_t>(caches, 1);
+	}
+
+	bool RenderedFrameCache::canStore(int w, int h)
+	{
+		return (size_t)w * h * 4 <= hotBudget();
+	}
+
+	bool RenderedFrameCache::fetch(const Key& key, int* bits, int rowspan)
+	{
+		lookups++;
+
+		auto found = hot.index.find(key);
+		if (found != hot.index.end())
+		{
+			// most recently used
+			hot.entries.splice(hot.entries.begin(), hot.entries, found->second);
+
+			copyRows(bits, rowspan, found->second->pixels.data(), (size_t)key.w * 4, (size_t)key.w * 4, key.h);
+
+			hits++;
+			return true;
+		}
+
+		found = compressed.index.find(key);
+		if (found != compressed.index.end())
+		{
+			decompress(found->second->pixels, key.w, key.h, bits, rowspan);
+			compressed.erase(found);
+
+			// back to the hot tier, it's being reused
+			store(key, bits, rowspan);
+
+			hits++;
+			return true;
+		}
+
+		return false;
+	}
+
+	void RenderedFrameCache::store(const Key& key, const int* bits, int rowspan)
+	{
+		if (!canStore(key.w, key.h))
+		{
+			// the share went down (more instances), what was kept may not fit anymore either
+			trim();
+			return;
+		}
+
+		auto found = hot.index.find(key);
+		if (found != hot.index.end())
+			hot.erase(found);
+
+		Entry entry{ key };
+		entry.pixels.resize((size_t)key.w * key.h);
+		copyRows(entry.pixels.data(), (size_t)key.w * 4, bits, rowspan, (size_t)key.w * 4, key.h);
+
+		hot.insert(std::move(entry));
+
+		trim();
+	}
+
+	void RenderedFrameCache::clear()
+	{
+		hot.clear();
+		compressed.clear();
+		hits = lookups = 0;
+	}
+
+	void RenderedFrameCache::trim()
+	{
+		size_t hotLimit = hotBudget();
+		size_t compressedLimit = compressedBudget();
+
+		while (hot.bytes > hotLimit)
+		{
+			Entry& last = hot.entries.back();
+
+			Entry encoded{ last.key };
+			if (compressedLimit && compress(last.pixels, last.key.w, encoded.pixels))
+			{
+				auto found = compressed.index.find(last.key);
+				if (found != compressed.index.end())
+					compressed.erase(found);
+
+				compressed.insert(std::move(encoded));
+			}
+
+			hot.erase(hot.index.find(last.key));
+		}
+
+		while (compressed.bytes > compressedLimit)
+			compressed.erase(compressed.index.find(compressed.entries.back().key));
+	}
+
+	bool RenderedFrameCache::compress(const std::vector<uint32_t>& pixels, int w, std::vector<uint32_t>& encoded)
+	{
+		// each pixel is xored with the one above, so repeated rows and flat areas become runs of zeros
+
+		// index of the header of the current literal run
+		size_t literalHeader = SIZE_MAX;
+		uint32_t zeroRun = 0;
+
+		auto flushZeroRun = [&]() {
+			if (zeroRun)
+				encoded.push_back(zeroRun);
+			zeroRun = 0;
+		};
+
+		// not worth it above half the size
+		size_t maxSize = pixels.size() / 2;
+
+		for (size_t i = 0; i < pixels.size(); i++)
+		{
+			uint32_t delta = i >= (size_t)w ? pixels[i] ^ pixels[i - w] : pixels[i];
+
+			if (delta == 0)
+			{
+				literalHeader = SIZE_MAX;
+				if (zeroRun == maxRun)
+					flushZeroRun();
+				zeroRun++;
+			}
+			else
+			{
+				flushZeroRun();
+
+				if (literalHeader == SIZE_MAX || (encoded[literalHeader] & maxRun) == maxRun)
+				{
+					literalHeader = encoded.size();
+					encoded.push_back(literalRunFlag);
+				}
+
+				encoded[literalHeader]++;
+				encoded.push_back(delta);
+			}
+
+			if (encoded.size() > maxSize)
+			{
+				encoded.clear();
+				return false;
+			}
+		}
+
+		flushZeroRun();
+
+		encoded.shrink_to_fit();
+		return true;
+	}
+
+	void RenderedFrameCache::decompress(const std::vector<uint32_t>& encoded, int w, int h, int* bits, int rowspan)
+	{
+		size_t pixel = 0;
+
+		auto put = [&](uint32_t delta) {
+			int x = (int)(pixel % w);
+			int y = (int)(pixel / w);
+
+			uint32_t* row = (uint32_t*)((uint8_t*)bits + (size_t)y * rowspan);
+			uint32_t above = y ? ((const uint32_t*)((const uint8_t*)bits + (size_t)(y - 1) * rowspan))[x] : 0;
+
+			row[x] = above ^ delta;
+			pixel++;
+		};
+
+		for (size_t i = 0; i < encoded.size();)
+		{
+			uint32_t header = encoded[i++];
+			uint32_t run = header & maxRun;
+
+			if (header & literalRunFlag)
+			{
+				for (uint32_t n = 0; n < run; n++)
+					put(encoded[i++]);
+			}
+			else
+			{
+				for (uint32_t n = 0; n < run; n++)
+					put(0);
+			}
+		}
+	}
+} // namespace ReaShader
@@ -0,0 +1,127 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace ReaShader
+{
+	/**
+	 * @brief Rendered rgba frames of processVideoFrame, so that scrubbing or looping over the same project time
+	 * doesn't render again.
+	 * Frames are kept in a byte budgeted LRU. Frames evicted from it can be kept in a second LRU, run length encoded,
+	 * if they compress well (flat or static content).
+	 * The budgets are for the whole process, each cache (one per plugin instance) keeps within an equal share of them.
+	 * Not thread safe, used by the video thread only.
+	 */
+	class RenderedFrameCache
+	{
+	  public:
+		struct Key
+		{
+			// hash of the input frame contents
+			uint64_t inputHash;
+			double projectTime;
+			// hash of the parameters the frame was rendered with
+			uint64_t paramsHash;
+			int w, h;
+
+			bool operator==(const Key& other) const
+			{
+				return inputHash == other.inputHash && projectTime == other.projectTime &&
+					   paramsHash == other.paramsHash && w == other.w && h == other.h;
+			}
+		};
+
+		RenderedFrameCache();
+		RenderedFrameCache(const RenderedFrameCache&) = delete;
+		~RenderedFrameCache();
+
+		/**
+		 * @brief Byte budgets of the two tiers across all the caches, 0 compressed bytes disables the compressed tier.
+		 * The caches evict what doesn't fit anymore on their next store.
+		 */
+		static void setBudget(size_t bytes, size_t compressedBytes);
+
+		/**
+		 * @brief Whether a frame of w by h fits the share of this cache (if not, there's no point in hashing it)
+		 */
+		bool canStore(int w, int h);
+
+		/**
+		 * @brief Copies the cached frame into bits (rows are rowspan bytes apart)
+		 * @return false if the frame is not cached
+		 */
+		bool fetch(const Key& key, int* bits, int rowspan);
+
+		/**
+		 * @brief Caches a copy of the rendered frame bits (rows are rowspan bytes apart)
+		 */
+		void store(const Key& key, const int* bits, int rowspan);
+
+		void clear();
+
+		// hits / lookups since the last clear()
+		float getHitRatio()
+		{
+			return lookups ? (float)hits / (float)lookups : 0.f;
+		}
+
+	  private:
+		struct KeyHash
+		{
+			size_t operator()(const Key& key) const;
+		};
+
+		struct Entry
+		{
+			Key key;
+			// tightly packed rgba rows, or run length encoded in the compressed tier
+			std::vector<uint32_t> pixels;
+		};
+
+		struct Tier
+		{
+			// most recently used first
+			std::list<Entry> entries;
+			std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+			size_t bytes{ 0 };
+
+			void insert(Entry&& entry);
+			void erase(std::unordered_map<Key, std::list<Entry>::iterator, KeyHash>::iterator found);
+			void clear();
+		};
+
+		// evicts the least recently used frames until the tiers are within budget, hot frames go compressed
+		void trim();
+
+		// fills the pixels of an entry of the compressed tier, false if it wouldn't save enough
+		static bool compress(const std::vector<uint32_t>& pixels, int w, std::vector<uint32_t>& encoded);
+		static void decompress(const std::vector<uint32_t>& encoded, int w, int h, int* bits, int rowspan);
+
+		// share of the budgets of this cache
+		size_t hotBudget();
+		size_t compressedBudget();
+
+		Tier hot;
+		Tier compressed;
+
+		// enough for a few seconds of 1080p with one instance, a few frames each with twenty
+		static std::atomic<size_t> budget;
+		static std::atomic<size_t> compressedBytesBudget;
+		static std::atomic<size_t> caches;
+
+		size_t hits{ 0 }, lookups{ 0 };
+	};
+} // namespace ReaShader
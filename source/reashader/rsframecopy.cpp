@@ -0,0 +1,276 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#include "rsframecopy.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RS_FRAMECOPY_SSE2
+#endif
+
+namespace ReaShader
+{
+	// above this the copy doesn't fit the cache anyway, streaming stores don't evict what the caller works on
+	static constexpr size_t largeCopyBytes = 4ull << 20;
+	// each thread gets at least this much, below it waking the thread costs more than it saves
+	static constexpr size_t bytesPerThread = 2ull << 20;
+	static constexpr uint32_t maxThreads = 4;
+
+	static void copyRow(uint8_t* dst, const uint8_t* src, size_t bytes, bool stream)
+	{
+#ifdef RS_FRAMECOPY_SSE2
+		if (stream)
+		{
+			// unaligned head with a plain copy, the stores need 16 byte alignment (the loads don't)
+
+			size_t head = std::min((16 - ((uintptr_t)dst & 15)) & 15, bytes);
+			memcpy(dst, src, head);
+			dst += head;
+			src += head;
+			bytes -= head;
+
+			for (; bytes >= 64; dst += 64, src += 64, bytes -= 64)
+			{
+				__m128i a = _mm_loadu_si128((const __m128i*)src);
+				__m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+				__m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+				__m128i d = _mm_loadu_si128((const __m128i*)(src + 48));
+				_mm_stream_si128((__m128i*)dst, a);
+				_mm_stream_si128((__m128i*)(dst + 16), b);
+				_mm_stream_si128((__m128i*)(dst + 32), c);
+				_mm_stream_si128((__m128i*)(dst + 48), d);
+			}
+
+			for (; bytes >= 16; dst += 16, src += 16, bytes -= 16)
+				_mm_stream_si128((__m128i*)dst, _mm_loadu_si128((const __m128i*)src));
+		}
+#endif
+		memcpy(dst, src, bytes);
+	}
+
+	static void copyRowRange(uint8_t* dst, size_t dstRowspan, const uint8_t* src, size_t srcRowspan, size_t rowBytes,
+							 uint32_t firstRow, uint32_t rows, bool stream)
+	{
+		dst += firstRow * dstRowspan;
+		src += firstRow * srcRowspan;
+
+		// tightly packed, one long row
+		if (dstRowspan == rowBytes && srcRowspan == rowBytes)
+		{
+			copyRow(dst, src, rowBytes * rows, stream);
+		}
+		else
+		{
+			for (uint32_t row = 0; row < rows; row++)
+				copyRow(dst + row * dstRowspan, src + row * srcRowspan, rowBytes, stream);
+		}
+
+#ifdef RS_FRAMECOPY_SSE2
+		// streaming stores are weakly ordered, visible before anything the caller does next (e.g. a gpu submit)
+		if (stream)
+			_mm_sfence();
+#endif
+	}
+
+	// persistent threads that run the bands of one copy at a time with the calling thread
+	class CopyWorkers
+	{
+	  public:
+		~CopyWorkers()
+		{
+			// still held at exit (no shutdown), the process takes the threads down
+			for (std::thread& thread : threads)
+				thread.detach();
+		}
+
+		void acquire(uint32_t count)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if (references++)
+				return;
+
+			if (!count)
+				count = std::min(maxThreads, std::max(std::thread::hardware_concurrency() / 2, 1u));
+
+			stopping = false;
+			for (uint32_t i = 1; i < count; i++)
+				threads.emplace_back(&CopyWorkers::work, this);
+		}
+
+		void release()
+		{
+			std::vector<std::thread> stopped;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				if (!references || --references)
+					return;
+
+				stopping = true;
+				stopped = std::move(threads);
+				threads.clear();
+			}
+
+			wake.notify_all();
+			for (std::thread& thread : stopped)
+				thread.join();
+		}
+
+		// calling thread included
+		uint32_t getThreadCount()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return static_cast<uint32_t>(threads.size()) + 1;
+		}
+
+		// runs band(0) to band(bands - 1) on the workers and the calling thread, false if they are busy with another
+		// copy (the caller copies alone then, it doesn't wait)
+		bool run(uint32_t bands, const std::function<void(uint32_t)>& band)
+		{
+			std::unique_lock<std::mutex> runLock(running, std::try_to_lock);
+			if (!runLock)
+				return false;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				if (threads.empty())
+					return false;
+
+				job = &band;
+				jobBands = bands;
+				nextBand = 0;
+				bandsDone = 0;
+				generation++;
+			}
+
+			wake.notify_all();
+
+			uint32_t done = runBands(band, bands);
+
+			std::unique_lock<std::mutex> lock(mutex);
+
+			// every worker that took the job is out of it before the band function goes away
+			bandsDone += done;
+			finished.wait(lock, [&]() { return bandsDone == bands && !activeWorkers; });
+			job = nullptr;
+
+			return true;
+		}
+
+	  private:
+		void work()
+		{
+			uint64_t seen = 0;
+
+			std::unique_lock<std::mutex> lock(mutex);
+
+			while (true)
+			{
+				wake.wait(lock, [&]() { return stopping || generation != seen; });
+				if (stopping)
+					return;
+
+				seen = generation;
+				if (!job)
+					continue;
+
+				const std::function<void(uint32_t)>* band = job;
+				uint32_t bands = jobBands;
+				activeWorkers++;
+
+				lock.unlock();
+				uint32_t done = runBands(*band, bands);
+				lock.lock();
+
+				bandsDone += done;
+				activeWorkers--;
+				finished.notify_all();
+			}
+		}
+
+		uint32_t runBands(const std::function<void(uint32_t)>& band, uint32_t bands)
+		{
+			uint32_t done = 0;
+			for (uint32_t next; (next = nextBand++) < bands; done++)
+				band(next);
+			return done;
+		}
+
+		std::mutex mutex;
+		std::condition_variable wake, finished;
+		std::vector<std::thread> threads;
+		uint32_t references{ 0 };
+		bool stopping{ false };
+
+		// one copy at a time
+		std::mutex running;
+		const std::function<void(uint32_t)>* job{ nullptr };
+		uint32_t jobBands{ 0 };
+		std::atomic<uint32_t> nextBand{ 0 };
+		uint32_t bandsDone{ 0 };
+		uint32_t activeWorkers{ 0 };
+		uint64_t generation{ 0 };
+	};
+
+	static CopyWorkers copyWorkers;
+
+	void acquireCopyWorkers(uint32_t threads)
+	{
+		copyWorkers.acquire(threads);
+	}
+
+	void releaseCopyWorkers()
+	{
+		copyWorkers.release();
+	}
+
+	void copyRows(void* dst, size_t dstRowspan, const void* src, size_t srcRowspan, size_t rowBytes, uint32_t rows)
+	{
+		size_t totalBytes = rowBytes * rows;
+		if (!totalBytes)
+			return;
+
+		bool large = totalBytes >= largeCopyBytes;
+
+		uint32_t bands = 1;
+		if (large)
+		{
+			bands = static_cast<uint32_t>(
+				std::min<size_t>({ copyWorkers.getThreadCount(), totalBytes / bytesPerThread, rows }));
+			bands = std::max(bands, 1u);
+		}
+
+		// contiguous bands of rows
+
+		uint32_t bandRows = (rows + bands - 1) / bands;
+
+		auto copyBand = [&](uint32_t band) {
+			uint32_t firstRow = band * bandRows;
+			if (firstRow < rows)
+				copyRowRange((uint8_t*)dst, dstRowspan, (const uint8_t*)src, srcRowspan, rowBytes, firstRow,
+							 std::min(bandRows, rows - firstRow), large);
+		};
+
+		if (bands > 1 && copyWorkers.run(bands, copyBand))
+			return;
+
+		copyRowRange((uint8_t*)dst, dstRowspan, (const uint8_t*)src, srcRowspan, rowBytes, 0, rows, large);
+	}
+} // namespace ReaShader
@@ -0,0 +1,31 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ReaShader
+{
+	/**
+	 * @brief Copies rows of rowBytes, rowspan apart in the source and in the destination (a single copy if both are
+	 * tightly packed). Meant for whole frames going to staging memory or video frames, which aren't read back soon:
+	 * large copies use non-temporal stores (SIMD when available) and are split across a few worker threads.
+	 */
+	void copyRows(void* dst, size_t dstRowspan, const void* src, size_t srcRowspan, size_t rowBytes, uint32_t rows);
+
+	/**
+	 * @brief The threads copyRows splits the large copies with are started once and kept waiting, while anything
+	 * holds them (the renderers from init to shutdown). They are joined by the last release, before the module can
+	 * be unloaded, and the copies run on the calling thread alone meanwhile.
+	 * threads counts the calling thread, 0 picks it from the cores (the first acquire starts them)
+	 */
+	void acquireCopyWorkers(uint32_t threads = 0);
+	void releaseCopyWorkers();
+} // namespace ReaShader
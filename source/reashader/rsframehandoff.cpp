@@ -0,0 +1,119 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#include "rsframehandoff.h"
+
+namespace ReaShader
+{
+	std::mutex FrameHandoff::mutex;
+	std::vector<FrameHandoff::Frame> FrameHandoff::frames;
+	std::vector<const void*> FrameHandoff::readingBack;
+	std::condition_variable FrameHandoff::readBacksDone;
+
+	void FrameHandoff::publish(Frame frame)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		frame.videoFrame->AddRef();
+
+		std::erase_if(frames, [&](Frame& published) {
+			if (published.producer != frame.producer && published.bits != frame.bits)
+				return false;
+			release(published);
+			return true;
+		});
+		frames.push_back(std::move(frame));
+	}
+
+	FrameHandoff::Frame FrameHandoff::retire(const void* producer)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		// a consumer may be writing the bits through the producer
+		readBacksDone.wait(lock, [&]() {
+			return std::find(readingBack.begin(), readingBack.end(), producer) == readingBack.end();
+		});
+
+		auto found = std::find_if(frames.begin(), frames.end(),
+								  [&](const Frame& frame) { return frame.producer == producer; });
+		if (found == frames.end())
+			return {};
+
+		Frame frame = std::move(*found);
+		frames.erase(found);
+		release(frame);
+		return frame;
+	}
+
+	bool FrameHandoff::claim(const int* bits, const void* consumer, DeviceManager::SharedDevice* device, int w,
+							 int h, Frame& frame)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		auto found = std::find_if(frames.begin(), frames.end(), [&](const Frame& frame) { return frame.bits == bits; });
+		if (found == frames.end() || found->producer == consumer)
+			return false;
+
+		// the image can be copied only on the same device, as is
+		if (found->image && found->device == device && found->w == w && found->h == h)
+		{
+			found->claimedBy = consumer;
+			frame = *found;
+			frame.videoFrame = nullptr; // the reference stays with the published frame
+			return true;
+		}
+
+		runReadBack(lock, found);
+		return false;
+	}
+
+	void FrameHandoff::consume(const int* bits, vkt::TimelinePoint point)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (Frame& frame : frames)
+			if (frame.bits == bits)
+				frame.consumed = point;
+	}
+
+	void FrameHandoff::resolve(const int* bits)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		auto found = std::find_if(frames.begin(), frames.end(), [&](const Frame& frame) { return frame.bits == bits; });
+		if (found != frames.end())
+			runReadBack(lock, found);
+	}
+
+	void FrameHandoff::runReadBack(std::unique_lock<std::mutex>& lock, std::vector<Frame>::iterator frame)
+	{
+		if (!frame->readBack)
+			return;
+
+		std::function<void()> run = std::move(frame->readBack);
+		frame->readBack = nullptr;
+
+		const void* producer = frame->producer;
+		readingBack.push_back(producer);
+
+		// outside the lock, the producer submits and waits (its frame stays published until retire sees this done)
+		lock.unlock();
+		run();
+		lock.lock();
+
+		readingBack.erase(std::find(readingBack.begin(), readingBack.end(), producer));
+		readBacksDone.notify_all();
+	}
+
+	void FrameHandoff::release(Frame& frame)
+	{
+		if (frame.videoFrame)
+			frame.videoFrame->Release();
+		frame.videoFrame = nullptr;
+	}
+} // namespace ReaShader
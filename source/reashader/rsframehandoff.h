@@ -0,0 +1,96 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#pragma once
+
+#include "rsdevicemanager.h"
+
+#include "vkt/vktimages.h"
+#include "vkt/vkttimeline.h"
+
+#include "video_frame.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+namespace ReaShader
+{
+	/**
+	 * @brief Rendered frames of the plugin instances, still on the gpu, keyed by the bits of the video frame they were
+	 * returned in. The next instance of the chain finds its input here and copies it on the gpu instead of uploading
+	 * it. A producer whose last frame was claimed, and whose output goes straight to the next instance, hands off the
+	 * next one without reading it back (the video frame bits are stale until resolve).
+	 * A published frame holds a reference to its video frame, so reaper can't give the bits to another frame while
+	 * they key it. One frame per producer, the readbacks run on the consumer thread through the producer (which
+	 * locks its frame slots) and a producer is retired only once none of them is running.
+	 */
+	class FrameHandoff
+	{
+	  public:
+		struct Frame
+		{
+			// referenced while published
+			IVideoFrame* videoFrame;
+			const int* bits;
+			int w, h;
+			DeviceManager::SharedDevice* device;
+			const void* producer;
+
+			// transfer src optimal, owned by the graphics queue family, valid until the producer renders again
+			vkt::Images::AllocatedImage* image;
+			vkt::TimelinePoint rendered;
+
+			// writes the frame to bits, empty once they hold it
+			std::function<void()> readBack;
+
+			// the consumer that copied it on the gpu (null if none), and that copy (the producer waits for it before
+			// reusing the image)
+			const void* claimedBy;
+			vkt::TimelinePoint consumed;
+		};
+
+		/**
+		 * @brief Replaces the previous frame of the producer (bits are the ones of videoFrame)
+		 */
+		static void publish(Frame frame);
+		/**
+		 * @brief Removes the frame of the producer, once its readbacks are done, and returns it (producer is null if
+		 * there was none). Must not be called while the producer keeps a readback from running.
+		 */
+		static Frame retire(const void* producer);
+
+		/**
+		 * @brief Finds the frame in bits for a consumer on device, at w by h.
+		 * Returns true with the frame if the consumer can copy the image (it has to if the frame is stale), false if
+		 * the bits have to be used (read back now if they are stale)
+		 */
+		static bool claim(const int* bits, const void* consumer, DeviceManager::SharedDevice* device, int w, int h,
+						  Frame& frame);
+		static void consume(const int* bits, vkt::TimelinePoint point);
+
+		/**
+		 * @brief Reads back the frame in bits if it's stale, for the consumers that need the bits
+		 */
+		static void resolve(const int* bits);
+
+	  private:
+		// runs the readback of the frame in bits if it has one, lock is released meanwhile
+		static void runReadBack(std::unique_lock<std::mutex>& lock, std::vector<Frame>::iterator frame);
+
+		// drops the reference to the video frame
+		static void release(Frame& frame);
+
+		static std::mutex mutex;
+		static std::vector<Frame> frames;
+
+		// producers of the readbacks running, retire waits for theirs
+		static std::vector<const void*> readingBack;
+		static std::condition_variable readBacksDone;
+	};
+} // namespace ReaShader
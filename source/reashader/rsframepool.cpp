@@ -0,0 +1,68 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#include "rsframepool.h"
+
+namespace ReaShader
+{
+	OutputFramePool::~OutputFramePool()
+	{
+		clear();
+	}
+
+	IVideoFrame* OutputFramePool::acquire(IREAPERVideoProcessor* vproc, int w, int h, int fmt)
+	{
+		Key key{ w, h, fmt };
+
+		// drop spares of other sizes, keep other formats of the same size (force_format may alternate)
+		for (auto it = spares.begin(); it != spares.end();)
+		{
+			if (std::get<0>(it->first) != w || std::get<1>(it->first) != h)
+			{
+				for (IVideoFrame* frame : it->second)
+					frame->Release();
+				it = spares.erase(it);
+			}
+			else
+				++it;
+		}
+
+		auto found = spares.find(key);
+		if (found != spares.end() && !found->second.empty())
+		{
+			IVideoFrame* frame = found->second.back();
+			found->second.pop_back();
+			return frame;
+		}
+
+		return vproc->newVideoFrame(w, h, fmt);
+	}
+
+	void OutputFramePool::recycle(IVideoFrame* frame)
+	{
+		if (!frame)
+			return;
+
+		std::vector<IVideoFrame*>& keySpares = spares[Key{ frame->get_w(), frame->get_h(), frame->get_fmt() }];
+
+		if (keySpares.size() < maxSparesPerKey)
+			keySpares.push_back(frame);
+		else
+			frame->Release();
+	}
+
+	void OutputFramePool::clear()
+	{
+		for (auto& [key, frames] : spares)
+		{
+			for (IVideoFrame* frame : frames)
+				frame->Release();
+		}
+		spares.clear();
+	}
+} // namespace ReaShader
@@ -0,0 +1,56 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#pragma once
+
+#include "video_processor.h"
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace ReaShader
+{
+	/**
+	 * @brief Output frames for process_frame, allocated with IREAPERVideoProcessor::newVideoFrame and keyed by size
+	 * and format.
+	 * A frame returned from process_frame belongs to reaper (it may keep it in its frame cache), so only frames that
+	 * were acquired but not returned (e.g. the renderer was halted) are recycled by the next calls.
+	 */
+	class OutputFramePool
+	{
+	  public:
+		OutputFramePool() = default;
+		OutputFramePool(const OutputFramePool&) = delete;
+		~OutputFramePool();
+
+		/**
+		 * @return a spare frame of the requested size and format, or a new one (nullptr if reaper can't allocate it)
+		 */
+		IVideoFrame* acquire(IREAPERVideoProcessor* vproc, int w, int h, int fmt);
+
+		/**
+		 * @brief Gives back a frame that was acquired and not returned to reaper
+		 */
+		void recycle(IVideoFrame* frame);
+
+		/**
+		 * @brief Releases all the spare frames, call before the video processor is deleted
+		 */
+		void clear();
+
+	  private:
+		// w, h, fmt
+		using Key = std::tuple<int, int, int>;
+
+		// spare frames per key, a different size drops the others (the frame size rarely changes)
+		std::map<Key, std::vector<IVideoFrame*>> spares;
+
+		static constexpr size_t maxSparesPerKey = 4;
+	};
+} // namespace ReaShader
@@ -8,10 +8,13 @@
 
 #include "rsprocessor.h"
 #include "mypluginprocessor.h"
+#include "rsdirtytiles.h"
 #include "rsparams/rsparams.h"
 #include "vkt/vktpipeline.h" 
 #include <stdlib.h> /* srand, rand */
 #include <time.h>	/* time */
+#include <cstring>
+#include <map>
 
 #include "reaper_plugin.h"
 // #include "reaper_plugin_functions.h"
@@ -23,11 +26,81 @@ using namespace Steinberg;
 
 namespace ReaShader
 {
+	// the instances of each track in the order they render the frames, the registry of the gpu hand-off (instances
+	// are their renderers, the ones FrameHandoff knows)
+	struct ChainPasses
+	{
+		struct Pass
+		{
+			double time;
+			// the instances that rendered the frame at time so far, and all the ones of the previous frame
+			std::vector<const void*> instances, previous;
+		};
+
+		static inline std::mutex mutex;
+		static inline std::map<const void*, Pass> passes;
+
+		// position of instance among the instances on track that rendered the frame at time so far (the same time
+		// rendered again by an instance starts a new pass)
+		static int rank(const void* track, const void* instance, double time)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Pass& pass = passes[track];
+			if (pass.time != time || std::find(pass.instances.begin(), pass.instances.end(), instance) !=
+										 pass.instances.end())
+			{
+				pass.time = time;
+				pass.previous = std::move(pass.instances);
+				pass.instances.clear();
+			}
+
+			pass.instances.push_back(instance);
+			return static_cast<int>(pass.instances.size()) - 1;
+		}
+
+		// whether next rendered right after instance, at rank, in the previous frame
+		static bool follows(const void* track, const void* instance, int rank, const void* next)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto found = passes.find(track);
+			if (found == passes.end() || rank < 0)
+				return false;
+
+			const std::vector<const void*>& previous = found->second.previous;
+			return (size_t)rank + 1 < previous.size() && previous[rank] == instance && previous[rank + 1] == next;
+		}
+
+		// drops a destroyed instance, and the tracks left without any
+		static void forget(const void* instance)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			for (auto entry = passes.begin(); entry != passes.end();)
+			{
+				Pass& pass = entry->second;
+				std::erase(pass.instances, instance);
+				std::erase(pass.previous, instance);
+
+				if (pass.instances.empty() && pass.previous.empty())
+					entry = passes.erase(entry);
+				else
+					entry++;
+			}
+		}
+	};
+
 	ReaShaderProcessor::ReaShaderProcessor(MyPluginProcessor* processor, FUnknown* context)
 		: myPluginProcessor(processor), context(context)
 	{
 	}
 
+	ReaShaderProcessor::~ReaShaderProcessor()
+	{
+		ChainPasses::forget(reaShaderRenderer.get());
+	}
+
 	template <typename P, typename... Args>
 	void ReaShaderProcessor::_registerParam(Args&&... args)
 	{
@@ -94,10 +167,34 @@ namespace ReaShader
 			.reactToRenderingDeviceChange([&](int newIndex) {
 				dynamic_cast<Parameters::Int8u&>(*processor_rsParams[Parameters::uRenderingDevice]).value = (Steinberg::Vst::ParamValue)newIndex;
 				reaShaderRenderer->changeRenderingDevice(newIndex);
+				renderGeneration++;
+			})
+			.reactToPostProcessChainChange([&](const json& passes) {
+				std::vector<ReaShaderRenderer::PostProcessPass> chain;
+				try
+				{
+					for (const json& pass : passes)
+						chain.push_back({ pass.at("shader").get<std::string>(),
+										  pass.value("inputs", std::vector<std::string>{}),
+										  pass.value("output", std::string{}), pass.value("compute", false),
+										  pass.value("pixel", false), pass.value("frameInputs", 0) });
+
+					// the video thread draws with the chain
+					std::lock_guard<std::mutex> frameLock(reaShaderRenderer->frameMutex);
+					reaShaderRenderer->setPostProcessChain(std::move(chain));
+				}
+				catch (STDEXC e)
+				{
+					LOG(WARNING, toConsole | toFile, "ReaShaderProcessor", "Invalid post process chain",
+						std::format("Received: {} | Error: {}", passes.dump(), e.what()));
+					return;
+				}
+				renderGeneration++;
 			})
 			.reactToParamAdd([&](std::unique_ptr<Parameters::IParameter> newParam) {
 				newParam->id = processor_rsParams.size();
 				processor_rsParams.push_back(std::move(newParam));
+				renderGeneration++;
 			})
 			.fallbackWarning("ReaShaderProcessor");
 	}
@@ -106,6 +203,8 @@ namespace ReaShader
 	{
 		if (info["paramId"] == Parameters::uCustomShaderName)
 		{
+			renderGeneration++;
+
 			// send shader to renderer (pp shader)
 			// -> init vulkan and device
 			// -> create the opaque material
@@ -153,6 +252,8 @@ namespace ReaShader
 			LOG(WARNING, toConsole | toFile | toBox, "ReaShaderProcessor", "RSPresetStreamer read error", std::move(msg));
 		});
 
+		renderGeneration++;
+
 		/*
 		// old
 		IBStreamer streamer(state, kLittleEndian);
@@ -202,10 +303,23 @@ namespace ReaShader
 					}
 				}
 
+				// offline render detection (adaptive resolution is off while rendering)
+
+				*(void**)&EnumProjects = reaperApp->getReaperApi("EnumProjects");
+
 				// get track info and send it to ui
 
 				MediaTrack* track = (MediaTrack*)reaperApp->getReaperParent(1);
 
+				// fx chain of the track, for the gpu hand-off (take fx are not in it)
+
+				this->track = reaperApp->getReaperParent(2) ? nullptr : track;
+
+				*(void**)&TrackFX_GetCount = reaperApp->getReaperApi("TrackFX_GetCount");
+				*(void**)&TrackFX_GetEnabled = reaperApp->getReaperApi("TrackFX_GetEnabled");
+				*(void**)&TrackFX_GetOffline = reaperApp->getReaperApi("TrackFX_GetOffline");
+				*(void**)&TrackFX_GetFXGUID = reaperApp->getReaperApi("TrackFX_GetFXGUID");
+
 				void* (*GetSetMediaTrackInfo)(MediaTrack* tr, const char* parmname, void* setNewValue);
 				*(void**)&GetSetMediaTrackInfo = reaperApp->getReaperApi("GetSetMediaTrackInfo");
 				if (GetSetMediaTrackInfo)
@@ -225,8 +339,43 @@ namespace ReaShader
 			}
 		}
 	}
+	bool ReaShaderProcessor::_nextFxIsReaShader(int chainRank)
+	{
+		if (!track || !TrackFX_GetCount || !TrackFX_GetEnabled || !TrackFX_GetFXGUID)
+			return false;
+
+		// the fx chain as it renders: which fx, in which order, the enabled ones
+
+		uint64_t chain = 0;
+		for (int fx = 0; fx < TrackFX_GetCount(track); fx++)
+		{
+			const void* guid = TrackFX_GetFXGUID(track, fx);
+			bool enabled = TrackFX_GetEnabled(track, fx) && !(TrackFX_GetOffline && TrackFX_GetOffline(track, fx));
+
+			chain = hashRows(&enabled, sizeof(enabled), 1, 0, chain);
+			if (guid)
+				chain = hashRows(guid, 16, 1, 0, chain);
+		}
+
+		bool chainChanged = chain != lastChain;
+		lastChain = chain;
+
+		if (chainChanged || !reaShaderRenderer->isHandOffClaimed())
+			return false;
+
+		// the instance that copied the last frame rendered right after this one, in the same chain: the output went
+		// straight to it (another fx in between would have rendered a new frame, it couldn't have copied it)
+		return ChainPasses::follows(track, reaShaderRenderer.get(), chainRank, reaShaderRenderer->getHandOffConsumer());
+	}
+
 	void ReaShaderProcessor::deactivate()
 	{
+		// the published frame references a frame of the video processor
+		FrameHandoff::retire(reaShaderRenderer.get());
+
+		outputFramePool.clear(); // spare frames belong to the video processor
+		renderedFrameCache.clear();
+
 		if (m_videoproc)
 			delete m_videoproc; // MUST !! (otherwise continue running processing)
 								// also must be here otherwise crash
@@ -282,25 +431,63 @@ namespace ReaShader
 		return false;
 	}
 
+	// hash of the meaningful bytes of a video frame (row padding excluded)
+	static uint64_t hashVideoFrame(const int* bits, int fmt, int w, int h, int rowspan)
+	{
+		if (fmt == 'YV12')
+		{
+			// Y, then V and U at half resolution with half the rowspan
+			uint64_t hash = hashRows(bits, w, h, rowspan, fmt);
+			return hashRows((const uint8_t*)bits + (size_t)rowspan * h, (w + 1) / 2, 2 * ((h + 1) / 2), rowspan / 2,
+							hash);
+		}
+		if (fmt == 'YUY2')
+			return hashRows(bits, ((w + 1) / 2) * 4, h, rowspan, fmt);
+
+		return hashRows(bits, (size_t)w * 4, h, rowspan, fmt);
+	}
+
 	IVideoFrame* processVideoFrame(IREAPERVideoProcessor* vproc, const double* parmlist, int nparms,
 								   double project_time, double frate, int force_format)
 	{
 		//  parmlist[0] is wet, [1] is parameter
 
-		IVideoFrame* vf = vproc->renderInputVideoFrame(0, 'RGBA');
+		ReaShaderProcessor* rsProcessor = (ReaShaderProcessor*)vproc->userdata;
+
+		// native format, yuv frames are converted on the gpu instead of by reaper, unless reaper asks for a format (the
+		// passthroughs below return the input as is, it must be in that format too)
+		IVideoFrame* vf = vproc->renderInputVideoFrame(0, force_format);
+
+		// the frame this instance handed off last time is done with (the previous instances just rendered theirs)
+		rsProcessor->reaShaderRenderer->retireHandedOffFrame();
+
+		// counted before anything can return, every enabled instance takes its place in the chain
+		int chainRank = rsProcessor->track
+							? ChainPasses::rank(rsProcessor->track, rsProcessor->reaShaderRenderer.get(), project_time)
+							: -1;
+
+		// the consumers of the last frame may read it back from their thread
+		std::lock_guard<std::mutex> frameLock(rsProcessor->reaShaderRenderer->frameMutex);
+
+		// fully dry, the input goes through untouched without any gpu work (its bits must hold the frame)
+		double wet = nparms > 0 ? parmlist[0] : 1.0;
+		if (wet <= 0.0)
+		{
+			if (vf)
+				FrameHandoff::resolve(vf->get_bits());
+			return vf;
+		}
 
 		if (vf)
 		{
 			int* bits = vf->get_bits();
-			// int rowspan = vf->get_rowspan() / 4;
+			int rowspan = vf->get_rowspan();
 			int w = vf->get_w();
 			int h = vf->get_h();
-			// int fmt = vf->get_fmt();
+			int fmt = vf->get_fmt();
 
 			// LICE_WrapperBitmap* bitmap = new LICE_WrapperBitmap((LICE_pixel*)bits, w, h, w, false);
 
-			ReaShaderProcessor* rsProcessor = (ReaShaderProcessor*)vproc->userdata;
-
 			rsProcessor->reaShaderRenderer->checkFrameSize(w, h);
 
 			/*for (int y = 0; y < parmlist[uVideoParam + 1] * h; y++) {
@@ -309,14 +496,145 @@ namespace ReaShader
 				}
 			}*/
 
-			rsProcessor->reaShaderRenderer->loadBitsToImage(bits);
+			// pass the input through while the renderer is halted (device change)
+			if (rsProcessor->reaShaderRenderer->isHalted())
+			{
+				FrameHandoff::resolve(bits);
+				return vf;
+			}
+
+			// rgba unless reaper asks for a format (e.g. an encoder), yuv is encoded on the gpu
+			int outFmt = force_format ? force_format : 'RGBA';
+
+			// the input frame is immutable (reaper may cache it), render into a pooled frame
+			IVideoFrame* outFrame = rsProcessor->outputFramePool.acquire(vproc, w, h, outFmt);
+			if (!outFrame)
+			{
+				FrameHandoff::resolve(bits);
+				return vf;
+			}
+
+			// the other inputs (picture in picture, transitions, grids) go to the gpu in the same upload, rgba at
+			// any size, the shaders sample input i as layer i. only the ones the chain samples are rendered
+
+			IVideoFrame* extraFrames[MAX_FRAME_INPUTS - 1]{};
+			ReaShaderRenderer::FrameInput extraInputs[MAX_FRAME_INPUTS - 1]{};
+			int extraInputCount = 0;
+
+			int inputCount =
+				std::min(vproc->getNumInputs(), 1 + rsProcessor->reaShaderRenderer->getFrameInputCount());
+			for (int i = 1; i < inputCount; i++)
+			{
+				IVideoFrame* input = vproc->renderInputVideoFrame(i, 'RGBA');
+				// layers stay contiguous, the first missing input ends them
+				if (!input)
+					break;
+
+				// uploaded from the bits, an instance on another track may have handed it off
+				FrameHandoff::resolve(input->get_bits());
+
+				extraFrames[extraInputCount] = input;
+				extraInputs[extraInputCount++] = { input->get_bits(), input->get_w(), input->get_h(),
+												   input->get_rowspan() };
+			}
+
+			auto releaseExtraFrames = [&]() {
+				for (int i = 0; i < extraInputCount; i++)
+					extraFrames[i]->Release();
+				extraInputCount = 0;
+			};
+
+			// the previous instance of the chain left its frame on the gpu, it's copied there (the bits may be stale)
+			bool handedIn = fmt == 'RGBA' && rsProcessor->reaShaderRenderer->claimHandedOffFrame(bits);
+
+			// a frame already rendered with the same input, time and parameters skips the gpu (scrubbing, loops)
+			bool cacheable = outFmt == 'RGBA' && rsProcessor->renderedFrameCache.canStore(w, h) &&
+							 (!handedIn || !rsProcessor->reaShaderRenderer->isHandedInFrameStale());
+			RenderedFrameCache::Key cacheKey{};
+
+			if (cacheable)
+			{
+				uint64_t paramsHash = hashRows(parmlist, nparms * sizeof(double), 1, 0, rsProcessor->renderGeneration);
+				paramsHash = hashRows(&frate, sizeof(frate), 1, 0, paramsHash);
+
+				uint64_t inputHash = hashVideoFrame(bits, fmt, w, h, rowspan);
+				for (int i = 0; i < extraInputCount; i++)
+				{
+					uint64_t extraHash = hashVideoFrame(extraInputs[i].bits, 'RGBA', extraInputs[i].w,
+														extraInputs[i].h, extraInputs[i].rowspan);
+					inputHash = hashRows(&extraHash, sizeof(extraHash), 1, 0, inputHash);
+				}
+
+				cacheKey = { inputHash, project_time, paramsHash, w, h };
+
+				if (rsProcessor->renderedFrameCache.fetch(cacheKey, outFrame->get_bits(), outFrame->get_rowspan()))
+				{
+					releaseExtraFrames();
+					vf->Release();
+					return outFrame;
+				}
+			}
+
+			// full resolution while rendering to file, the adaptive resolution is for realtime playback only
+			rsProcessor->reaShaderRenderer->setOfflineRender(rsProcessor->EnumProjects &&
+															 rsProcessor->EnumProjects(0x40000000, nullptr, 0));
+
+			rsProcessor->reaShaderRenderer->setFrameInputs(extraInputs, extraInputCount);
+
+			// the input is kept until the readback is submitted (the gpu may still read the bits), it goes through if
+			// the frame can't be read back
+			if (!handedIn || !rsProcessor->reaShaderRenderer->loadHandedOffFrame())
+			{
+				if (handedIn)
+					FrameHandoff::resolve(bits);
+				rsProcessor->reaShaderRenderer->loadBitsToImage(bits, fmt, rowspan);
+			}
+
+			// copied to the staging by loadBitsToImage
+			releaseExtraFrames();
 
 			float videoParam = parmlist[Parameters::uVideoParam + 1];
-			double pushConstants[] = { project_time, frate, videoParam };
+			double pushConstants[] = { project_time, frate, videoParam, wet };
 
 			rsProcessor->reaShaderRenderer->drawFrame(pushConstants);
 
-			rsProcessor->reaShaderRenderer->transferFrame(bits);
+			int* outBits = outFrame->get_bits();
+
+			// the next instance copied the last frame on the gpu and the frame goes straight to it, hand this one
+			// off too (no readback, the bits are written only if the next instance turns out to need them)
+			// anywhere else (video window, render, other fx, bypassed instance) the bits must hold the frame
+			if (outFmt == 'RGBA' && rsProcessor->_nextFxIsReaShader(chainRank) &&
+				rsProcessor->reaShaderRenderer->handOffFrame(outFrame))
+			{
+				vf->Release();
+				return outFrame;
+			}
+
+			int readbackSlot =
+				rsProcessor->reaShaderRenderer->submitReadback(outBits, outFmt, outFrame->get_rowspan());
+
+			if (readbackSlot < 0)
+			{
+				// halted meanwhile, nothing was drawn into the frame, the input goes through
+				rsProcessor->outputFramePool.recycle(outFrame);
+				FrameHandoff::resolve(bits);
+				return vf;
+			}
+
+			// reaper needs the frame when we return, nothing else to overlap with here
+			rsProcessor->reaShaderRenderer->finishReadback(readbackSlot);
+
+			vf->Release();
+
+			// frames drawn at a reduced scale are not kept, hits would keep serving them once the gpu catches up
+			if (cacheable && rsProcessor->reaShaderRenderer->getLastRenderScale() == 1.f)
+				rsProcessor->renderedFrameCache.store(cacheKey, outBits, outFrame->get_rowspan());
+
+			// the next instance may find it and copy the image instead of uploading the bits
+			if (outFmt == 'RGBA')
+				rsProcessor->reaShaderRenderer->publishFrame(outFrame, readbackSlot);
+
+			return outFrame;
 		}
 
 		return vf;
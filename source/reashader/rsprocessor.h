@@ -21,11 +21,16 @@ using json = nlohmann::json;
 
 using namespace Steinberg;
 
+#include "rsframecache.h"
+#include "rsframepool.h"
 #include "rsrenderer.h"
 #include "rsui/api.h"
 
+#include <atomic>
 #include <mutex>
 
+class MediaTrack;
+
 namespace ReaShader
 {
 	FWD_DECL(MyPluginProcessor);
@@ -39,6 +44,7 @@ namespace ReaShader
 	{
 	  public:
 		ReaShaderProcessor(MyPluginProcessor* processor, FUnknown* context);
+		~ReaShaderProcessor();
 
 		void initialize();
 		/**
@@ -96,6 +102,35 @@ namespace ReaShader
 		int myColor{ 0 };
 
 		IREAPERVideoProcessor* m_videoproc{ nullptr };
+
+		// EnumProjects(0x40000000, ...) returns the project being rendered, if any
+		void* (*EnumProjects)(int idx, char* projfnOutOptional, int projfnOutOptional_sz){ nullptr };
+
+		// the fx chain of the track, to know if the output goes straight to another instance (null on take fx)
+		MediaTrack* track{ nullptr };
+		int (*TrackFX_GetCount)(MediaTrack* track){ nullptr };
+		bool (*TrackFX_GetEnabled)(MediaTrack* track, int fx){ nullptr };
+		bool (*TrackFX_GetOffline)(MediaTrack* track, int fx){ nullptr };
+		// GUID*
+		const void* (*TrackFX_GetFXGUID)(MediaTrack* track, int fx){ nullptr };
+
+		/**
+		 * @brief Whether the output goes straight to the next ReaShader instance of the track: the instance that copied
+		 * the last frame rendered right after this one, and the fx chain hasn't changed since
+		 * @param chainRank position of this instance among the ReaShader instances that rendered the current frame
+		 */
+		bool _nextFxIsReaShader(int chainRank);
+		// hash of the fx chain at the last call
+		uint64_t lastChain{ 0 };
+
+		// output frames of processVideoFrame
+		OutputFramePool outputFramePool;
+
+		// rendered frames of processVideoFrame, for scrubbing and loops
+		RenderedFrameCache renderedFrameCache;
+		// bumped when something that is not in the video parameters changes the rendering (device, shader, preset),
+		// so the cached frames aren't hit anymore
+		std::atomic<uint64_t> renderGeneration{ 0 };
 		
 	};
 } // namespace ReaShader
\ No newline at end of file
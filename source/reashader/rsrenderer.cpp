@@ -7,6 +7,7 @@
  *****************************************************************************/
 
 #include "rsrenderer.h"
+#include "rsframecopy.h"
 #include "rsparams/rsparams.h"
 #include "rsprocessor.h"
 #include "tools/compiler_codes.h"
@@ -22,7 +23,11 @@
 #pragma warning(pop)
 /* ---- */
 
-#define MAX_OBJECTS 100
+// objects the scene draws of a frame slot hold at first, grown to the next power of two of the scene
+#define SCENE_DRAWS_MIN_CAPACITY 64u
+// transients of the render graph unused for this many frames are freed (scale levels and frame sizes left behind),
+// more than FRAMES_IN_FLIGHT so the gpu is done with them
+#define TRANSIENT_IDLE_FRAMES 120u
 
 #include "tools/paths.h"
 #include <tools/exceptions.h>
@@ -54,6 +59,8 @@ namespace ReaShader
 
 	void ReaShaderRenderer::init()
 	{
+		acquireCopyWorkers();
+
 		// init vulkan
 
 		try
@@ -74,6 +81,8 @@ namespace ReaShader
 
 	void ReaShaderRenderer::shutdown()
 	{
+		releaseCopyWorkers();
+
 		// clean up vulkan
 
 		if (exceptionOnInitialize)
@@ -96,17 +105,18 @@ namespace ReaShader
 		if (halted)
 			return;
 
-		// assume if width changed all aspec ratio changed, come on...
-		if (w != FRAME_W)
+		if (w != FRAME_W || h != FRAME_H)
 		{
+			// readbacks still pending were submitted at the old size
+			for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++)
+				finishReadback(static_cast<int>(i));
+
 			// update frame size
 			FRAME_W = w;
 			FRAME_H = h;
 
-			// wait, flush, recreate
-			vktDevice->getGraphicsQueue()->waitIdle();
-			vktFrameResizedDeletionQueue.flush();
-			createRenderTargets();
+			// pooled per size, no queue drain (the replaced set is kept for when the size comes back)
+			useRenderTargets();
 
 			// call listener
 			if (listener)
@@ -121,14 +131,17 @@ namespace ReaShader
 			global_uniform_buffer = 0,
 			global_uniform_buffer_dynamic,
 			object_storage_buffer = 0,
+			cull_objects = 0,
+			cull_commands,
+			cull_counts,
+			cull_instances,
 			texture_combined_image_sampler = 0,
-			sampled_frame
-		};
-
-		enum commandBuffers
-		{
-			draw,
-			transfer,
+			sampled_frame,
+			input_layers,
+			frame_planes_storage_buffer = 0,
+			rendered_frame = 0,
+			post_process_inputs = 0,
+			post_process_target
 		};
 
 		enum meshes
@@ -147,7 +160,9 @@ namespace ReaShader
 		enum materials
 		{
 			opaque,
-			post_process
+			yuv_to_rgb,
+			rgb_to_yuv,
+			dry_mix
 		};
 	} defaultIds;
 
@@ -157,13 +172,106 @@ namespace ReaShader
 	{
 		glm::int32 objectId;
 		glm::float32 videoParam;
+		glm::int32 inputCount; // valid input layers, 1 if only the processed frame
 	};
 
+	// as the culling reads the render objects (std430)
 	struct RenderObjectData
 	{
-		glm::mat4 finalModelMatrix;
+		glm::mat4 localTransform;
+		glm::vec4 boundingSphere;
+		glm::uint32 firstDraw; // of the batch
+		glm::uint32 batch;
+		glm::uint32 elementCount;
+		glm::uint32 pad;
+	};
+
+	struct CullPushConstants
+	{
+		glm::mat4 viewproj;
+		glm::mat4 sceneTransform;
+	};
+
+	// applied to all the render objects, turning with the project time
+	static glm::mat4 sceneTransform(double pushConstants[])
+	{
+		double proj_time = pushConstants[0];
+		double frameNumber = proj_time * pushConstants[1]; // proj_time * frate
+		return glm::rotate(glm::mat4{ 1.0f }, (float)glm::radians(frameNumber * 1.f),
+						   glm::vec3(0.1f * sin(proj_time), 1, 0.05f * cos(proj_time)));
+	}
+
+	// INGEST
+
+	struct YuvPushConstants
+	{
+		glm::int32 format; // 0 YV12, 1 YUY2
+		glm::int32 matrix; // 0 BT.601, 1 BT.709
+		glm::int32 width;
+		glm::int32 height;
 	};
 
+	// size of the tightly packed planes of a yuv frame (the biggest of the supported formats), in whole words since
+	// the shader reads the planes as uints
+	static size_t yuvPlanesSize(uint32_t w, uint32_t h)
+	{
+		size_t yv12 = (size_t)w * h + 2 * (size_t)((w + 1) / 2) * ((h + 1) / 2);
+		size_t yuy2 = (size_t)((w + 1) / 2) * 4 * h;
+		return (std::max(yv12, yuy2) + 3) & ~(size_t)3;
+	}
+
+	// calls copyPlane(packedOffset, frameOffset, rowBytes, rows, frameRowspan) for each plane of a yuv frame
+	template <typename F> static void forEachYuvPlane(int fmt, uint32_t w, uint32_t h, uint32_t rowspan, F&& copyPlane)
+	{
+		if (fmt == 'YV12')
+		{
+			// Y, then V and U at half resolution with half the rowspan
+			uint32_t cw = (w + 1) / 2;
+			uint32_t ch = (h + 1) / 2;
+			uint32_t chromaRowspan = rowspan / 2;
+
+			copyPlane(0, 0, w, h, rowspan);
+			copyPlane((size_t)w * h, (size_t)rowspan * h, cw, ch, chromaRowspan);
+			copyPlane((size_t)w * h + (size_t)cw * ch, (size_t)rowspan * h + (size_t)chromaRowspan * ch, cw, ch,
+					  chromaRowspan);
+		}
+		else // YUY2
+		{
+			copyPlane(0, 0, ((w + 1) / 2) * 4, h, rowspan);
+		}
+	}
+
+	// copies the planes of a yuv frame without the row padding
+	static void packYuvPlanes(uint8_t* dst, const uint8_t* src, int fmt, uint32_t w, uint32_t h, uint32_t rowspan)
+	{
+		forEachYuvPlane(fmt, w, h, rowspan,
+						[&](size_t packedOffset, size_t frameOffset, uint32_t rowBytes, uint32_t rows,
+							uint32_t frameRowspan) {
+							copyRows(dst + packedOffset, rowBytes, src + frameOffset, frameRowspan, rowBytes, rows);
+						});
+	}
+
+	// copies tightly packed planes into a yuv frame
+	static void unpackYuvPlanes(uint8_t* dst, const uint8_t* src, int fmt, uint32_t w, uint32_t h, uint32_t rowspan)
+	{
+		forEachYuvPlane(fmt, w, h, rowspan,
+						[&](size_t packedOffset, size_t frameOffset, uint32_t rowBytes, uint32_t rows,
+							uint32_t frameRowspan) {
+							copyRows(dst + frameOffset, frameRowspan, src + packedOffset, rowBytes, rowBytes, rows);
+						});
+	}
+
+	// extent of the r8 target holding the packed planes of a yuv frame (YV12 rows are w bytes, YUY2 rows are w * 2)
+	static VkExtent2D yuvEncodedExtent(int fmt, uint32_t w, uint32_t h)
+	{
+		if (fmt == 'YV12')
+		{
+			size_t chromaBytes = 2 * (size_t)((w + 1) / 2) * ((h + 1) / 2);
+			return { w, h + static_cast<uint32_t>((chromaBytes + w - 1) / w) };
+		}
+		return { ((w + 1) / 2) * 4, h };
+	}
+
 	void ReaShaderRenderer::updateVirtualScene(double pushConstants[])
 	{
 		double proj_time = pushConstants[0];
@@ -185,27 +293,18 @@ namespace ReaShader
 		virtualSceneData.sceneBuffer->putData(&envData, sizeof(VirtualEnvironmentData));
 	}
 
-	void ReaShaderRenderer::drawFrame(double pushConstants[])
+	void ReaShaderRenderer::recordScene(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, VkExtent2D extent,
+									   double pushConstants[])
 	{
-		if (halted)
-			return;
-
-		vkt::CommandPool* commandPool = vktDevice->getGraphicsCommandPool();
-		VkCommandBuffer commandBuffer = vkDrawCommandBuffer;
-		VkExtent2D extent{ FRAME_W, FRAME_H };
-
-		// begin command buffer
-		commandPool->restartCommandBuffer(commandBuffer);
-
 		// begin render pass
 		VkRenderPassBeginInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 		renderPassInfo.renderPass = vkRenderPass;
-		renderPassInfo.framebuffer = vkFramebuffer;
+		renderPassInfo.framebuffer = framebuffer;
 		renderPassInfo.renderArea.offset = { 0, 0 };
 		renderPassInfo.renderArea.extent = extent;
 
-		VkClearValue clearColor = { { { 0.0f, 0.0f, 0.0f, 0.0f } } }; // transparent
+		VkClearValue clearColor = { { { 0.0f, 0.0f, 0.0f, 0.0f } } }; // unused, the color is loaded
 
 		// clear depth at 1
 		VkClearValue depthClear{};
@@ -218,276 +317,1389 @@ namespace ReaShader
 
 		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-		// virtual scene data
-		updateVirtualScene(pushConstants);
+		// dynamic states
 
-		// update objects
-		double proj_time = pushConstants[0];
-		double frameNumber = proj_time * pushConstants[1]; // proj_time * frate
-		glm::mat4 modelTransform = glm::rotate(glm::mat4{ 1.0f }, (float)glm::radians(frameNumber * 1.f),
-											   glm::vec3(0.1f * sin(proj_time), 1, 0.05f * cos(proj_time)));
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = static_cast<float>(extent.height);
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = -static_cast<float>(extent.height); // flipping viewport for vulkan :* <3 UwU
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-		void* data;
-		virtualSceneData.objectBuffer->map(&data);
+		VkRect2D scissor{};
+		scissor.offset = { 0, 0 };
+		scissor.extent = extent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-		// render objects
+		// render objects, a batch of indirect draws (written by the culling) per material and mesh
+
+		FrameSlot& frameSlot = getCurrentFrameSlot();
 
-		RenderObjectData* objectSSBO = (RenderObjectData*)data;
+		VkBuffer drawCommands = frameSlot.sceneDraws.commands ? frameSlot.sceneDraws.commands->getBuffer() : nullptr;
+		constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
 
 		vkt::Rendering::Mesh* lastMesh = nullptr;
 		vkt::Rendering::Material* lastMaterial = nullptr;
-		for (int i = 0; i < renderObjects.size(); i++)
+		for (uint32_t b = 0; drawCommands && b < scene.batches.size(); b++)
 		{
-			vkt::Rendering::RenderObject& object = renderObjects[i];
-
-			// write storage buffers
-			objectSSBO[i].finalModelMatrix = modelTransform * object.localTransformMatrix;
+			const SceneBatch& batch = scene.batches[b];
 
 			// only bind the pipeline if it doesn't match with the already bound one
-			if (object.material != lastMaterial)
+			if (batch.material != lastMaterial)
 			{
-				// dynamic states
-
-				VkViewport viewport{};
-				viewport.x = 0.0f;
-				viewport.y = static_cast<float>(extent.height);
-				viewport.width = static_cast<float>(extent.width);
-				viewport.height = -static_cast<float>(extent.height); // flipping viewport for vulkan :* <3 UwU
-				viewport.minDepth = 0.0f;
-				viewport.maxDepth = 1.0f;
-				vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-				VkRect2D scissor{};
-				scissor.offset = { 0, 0 };
-				scissor.extent = extent;
-				vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipeline);
-				lastMaterial = object.material;
-
-				// bind the descriptor set when changing pipeline
-				object.material->cmdBindDescriptors(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.material->pipeline);
+				lastMaterial = batch.material;
+
+				// bind the descriptor set when changing pipeline, the instances are the ones of the slot
+				batch.material->cmdBindDescriptors(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.material->pipelineLayout,
+										1, 1, &frameSlot.sceneDraws.instanceSet.set, 0, nullptr);
 			}
 
 			// set push constants
 
-			// model rotation
+			// the draws index the instances from the first one of the batch
 			DefaultPushConstants constants{};
-			constants.objectId = i;
+			constants.objectId = batch.firstDraw;
 			constants.videoParam = pushConstants[2];
+			constants.inputCount = static_cast<glm::int32>(frameSlot.inputCount);
 
 #pragma warning(suppress : W_PTR_MIGHT_BE_NULL) // assert material is not nullptr
-			object.material->cmdPushConstants(commandBuffer, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-											  &constants, 0);
+			batch.material->cmdPushConstants(commandBuffer, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+											 &constants, 0);
 
 			// only bind the mesh if it's a different one from last bind
 
-			if (object.mesh != lastMesh)
+			if (batch.mesh != lastMesh)
 			{
 				// bind the mesh vertex buffer with offset 0
 				VkDeviceSize offset = 0;
-				VkBuffer vertexBuffer = object.mesh->getVertexBuffer()->getBuffer();
+				VkBuffer vertexBuffer = batch.mesh->getVertexBuffer()->getBuffer();
 				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &(vertexBuffer), &offset);
 
 				// only bind index buffer if it's used
-				if (object.mesh->getIndexBuffer()->getBuffer())
-					vkCmdBindIndexBuffer(commandBuffer, object.mesh->getIndexBuffer()->getBuffer(), 0,
+				if (batch.indexed)
+					vkCmdBindIndexBuffer(commandBuffer, batch.mesh->getIndexBuffer()->getBuffer(), 0,
 										 VK_INDEX_TYPE_UINT32);
 
-				lastMesh = object.mesh;
+				lastMesh = batch.mesh;
 			}
 
 			// we can now draw
 
-			if (object.mesh->getIndexBuffer()->getBuffer())
-				vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(object.mesh->getIndices().size()), 1, 0, 0, 0);
+			VkDeviceSize offset = batch.firstDraw * stride;
+
+			if (scene.indirectCount)
+			{
+				VkBuffer drawCounts = frameSlot.sceneDraws.counts->getBuffer();
+				VkDeviceSize countOffset = b * sizeof(uint32_t);
+
+				if (batch.indexed)
+					vktDevice->ext.cmdDrawIndexedIndirectCount(commandBuffer, drawCommands, offset, drawCounts,
+															   countOffset, batch.maxDraws, stride);
+				else
+					vktDevice->ext.cmdDrawIndirectCount(commandBuffer, drawCommands, offset, drawCounts, countOffset,
+														batch.maxDraws, stride);
+			}
+			else if (scene.multiDraw)
+			{
+				// the culled draws are empty
+				if (batch.indexed)
+					vkCmdDrawIndexedIndirect(commandBuffer, drawCommands, offset, batch.maxDraws, stride);
+				else
+					vkCmdDrawIndirect(commandBuffer, drawCommands, offset, batch.maxDraws, stride);
+			}
 			else
-				vkCmdDraw(commandBuffer, static_cast<uint32_t>(object.mesh->getVertices().size()), 1, 0, 0);
+			{
+				// one draw per call (the draw index is always 0)
+				for (uint32_t i = 0; i < batch.maxDraws; i++)
+				{
+					constants.objectId = batch.firstDraw + i;
+					batch.material->cmdPushConstants(
+						commandBuffer, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, &constants, 0);
+
+					if (batch.indexed)
+						vkCmdDrawIndexedIndirect(commandBuffer, drawCommands, offset + i * stride, 1, stride);
+					else
+						vkCmdDrawIndirect(commandBuffer, drawCommands, offset + i * stride, 1, stride);
+				}
+			}
 		}
 
-		// unmap storage buffers
-		virtualSceneData.objectBuffer->unmap();
+		// wet/dry mix, the unprocessed frame (post process source) is blended over everything that was drawn
+
+		double wet = pushConstants[3];
+
+		if (wet < 1.0)
+		{
+			vkt::Rendering::Material* material = materials.get(defaultIds::materials::dry_mix);
+
+			// viewport and scissor are the ones set for the objects (same mapping as the post process quad)
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipeline);
+			material->cmdBindDescriptors(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+			float blendConstants[4] = { 0.f, 0.f, 0.f, static_cast<float>(1.0 - std::max(wet, 0.0)) };
+			vkCmdSetBlendConstants(commandBuffer, blendConstants);
+
+			vkt::Rendering::Mesh* quad = *meshes.get(defaultIds::meshes::quad);
+			VkDeviceSize offset = 0;
+			VkBuffer vertexBuffer = quad->getVertexBuffer()->getBuffer();
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+			vkCmdDraw(commandBuffer, static_cast<uint32_t>(quad->getVertices().size()), 1, 0, 0);
+		}
 
 		// end render pass
 
 		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	void ReaShaderRenderer::updateScene()
+	{
+		// objects of the same material and mesh next to each other, a batch per run
+
+		scene.order.resize(renderObjects.size());
+		std::iota(scene.order.begin(), scene.order.end(), 0);
+		std::stable_sort(scene.order.begin(), scene.order.end(), [&](uint32_t a, uint32_t b) {
+			return std::make_pair((uintptr_t)renderObjects[a].material, (uintptr_t)renderObjects[a].mesh) <
+				   std::make_pair((uintptr_t)renderObjects[b].material, (uintptr_t)renderObjects[b].mesh);
+		});
+
+		scene.batches.clear();
+		for (uint32_t i = 0; i < scene.order.size(); i++)
+		{
+			vkt::Rendering::RenderObject& object = renderObjects[scene.order[i]];
+
+			if (scene.batches.empty() || scene.batches.back().material != object.material ||
+				scene.batches.back().mesh != object.mesh)
+			{
+				bool indexed = object.mesh->getIndexBuffer()->getBuffer();
+				uint32_t elementCount = static_cast<uint32_t>(indexed ? object.mesh->getIndices().size()
+																	  : object.mesh->getVertices().size());
+				scene.batches.push_back({ object.material, object.mesh, indexed, elementCount, i, 0 });
+			}
+
+			scene.batches.back().maxDraws++;
+		}
+
+		scene.version++;
+	}
+
+	void ReaShaderRenderer::prepareSceneDraws(FrameSlot& frameSlot)
+	{
+		FrameSlot::SceneDraws& draws = frameSlot.sceneDraws;
+
+		if (!scene.supported || scene.order.empty() || draws.version == scene.version)
+			return;
+
+		// the previous use of the slot has completed, its buffers can be replaced and its sets rewritten
+
+		uint32_t objectCount = static_cast<uint32_t>(scene.order.size());
+
+		if (objectCount > draws.capacity)
+		{
+			for (vkt::Buffers::AllocatedBuffer* buffer :
+				 { draws.objects, draws.commands, draws.counts, draws.instances })
+				if (buffer)
+					buffer->destroy();
+
+			draws.capacity = std::max(draws.capacity, SCENE_DRAWS_MIN_CAPACITY);
+			while (draws.capacity < objectCount)
+				draws.capacity *= 2;
+
+			// the draws are written and read on the gpu only, the commands and counts are cleared before the culling
+
+			VkBufferUsageFlags drawUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+										   VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+			draws.objects = (new vkt::Buffers::AllocatedBuffer(vktDevice, false))
+								->allocate(sizeof(RenderObjectData) * draws.capacity,
+										   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+										   VMA_ALLOCATION_CREATE_MAPPED_BIT |
+											   VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+			draws.commands = (new vkt::Buffers::AllocatedBuffer(vktDevice, false))
+								 ->allocate(sizeof(VkDrawIndexedIndirectCommand) * draws.capacity, drawUsage,
+											VMA_MEMORY_USAGE_GPU_ONLY);
+			draws.counts = (new vkt::Buffers::AllocatedBuffer(vktDevice, false))
+							   ->allocate(sizeof(uint32_t) * draws.capacity, drawUsage, VMA_MEMORY_USAGE_GPU_ONLY);
+			draws.instances = (new vkt::Buffers::AllocatedBuffer(vktDevice, false))
+								  ->allocate(sizeof(glm::mat4) * draws.capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+											 VMA_MEMORY_USAGE_GPU_ONLY);
+		}
+
+		// objects in batch order, the draws of a batch are in the range of its objects
+
+		RenderObjectData* objects = (RenderObjectData*)draws.objects->getMappedData();
+
+		for (uint32_t b = 0; b < scene.batches.size(); b++)
+		{
+			const SceneBatch& batch = scene.batches[b];
+			glm::vec4 boundingSphere = batch.mesh->getBoundingSphere();
+
+			for (uint32_t i = batch.firstDraw; i < batch.firstDraw + batch.maxDraws; i++)
+				objects[i] = { renderObjects[scene.order[i]].localTransformMatrix, boundingSphere, batch.firstDraw, b,
+							   batch.elementCount, 0 };
+		}
+
+		VK_CHECK_RESULT(
+			vmaFlushAllocation(vktDevice->vmaAllocator, draws.objects->getAllocation(), 0, VK_WHOLE_SIZE))
+
+		// the culling runs over the objects in its binding
+
+		vkt::Descriptors::DescriptorSetWriter(vktDevice)
+			.selectDescriptorSet(draws.cullSet)
+			.selectBinding(defaultIds::descriptorBindings::cull_objects)
+			.registerWriteBuffer(draws.objects, sizeof(RenderObjectData) * objectCount, 0)
+			.selectBinding(defaultIds::descriptorBindings::cull_commands)
+			.registerWriteBuffer(draws.commands, sizeof(VkDrawIndexedIndirectCommand) * draws.capacity, 0)
+			.selectBinding(defaultIds::descriptorBindings::cull_counts)
+			.registerWriteBuffer(draws.counts, sizeof(uint32_t) * draws.capacity, 0)
+			.selectBinding(defaultIds::descriptorBindings::cull_instances)
+			.registerWriteBuffer(draws.instances, sizeof(glm::mat4) * draws.capacity, 0)
+
+			.selectDescriptorSet(draws.instanceSet)
+			.selectBinding(defaultIds::descriptorBindings::object_storage_buffer)
+			.registerWriteBuffer(draws.instances, sizeof(glm::mat4) * draws.capacity, 0)
+
+			.writeRegistered();
+
+		draws.version = scene.version;
+	}
+
+	void ReaShaderRenderer::recordCulling(VkCommandBuffer commandBuffer, FrameSlot& frameSlot,
+										  double pushConstants[])
+	{
+		FrameSlot::SceneDraws& draws = frameSlot.sceneDraws;
+
+		// the counts start from 0, without the gpu counts all the max draws are called and the culled ones must be
+		// empty
+
+		vkCmdFillBuffer(commandBuffer, draws.counts->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+		vkt::commands::insertBufferMemoryBarrier(
+			commandBuffer, draws.counts->getBuffer(), VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		if (!scene.indirectCount)
+		{
+			vkCmdFillBuffer(commandBuffer, draws.commands->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+			vkt::commands::insertBufferMemoryBarrier(commandBuffer, draws.commands->getBuffer(),
+													 VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+													 VK_PIPELINE_STAGE_TRANSFER_BIT,
+													 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		}
+
+		// one invocation per object
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, scene.cullMaterial.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, scene.cullMaterial.pipelineLayout, 0, 1,
+								&draws.cullSet.set, 0, nullptr);
+
+		CullPushConstants constants{ camData.viewproj, sceneTransform(pushConstants) };
+		scene.cullMaterial.cmdPushConstants(commandBuffer, VK_SHADER_STAGE_COMPUTE_BIT, &constants, 0);
+
+		scene.cullMaterial.cmdDispatch(commandBuffer, static_cast<uint32_t>(scene.order.size()), 1);
+
+		// read by the scene pass, as indirect commands and by the vertex shader (the graph tracks the images only)
+
+		for (vkt::Buffers::AllocatedBuffer* buffer : { draws.commands, draws.counts })
+			vkt::commands::insertBufferMemoryBarrier(commandBuffer, buffer->getBuffer(), VK_ACCESS_SHADER_WRITE_BIT,
+													 VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+													 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+													 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+		vkt::commands::insertBufferMemoryBarrier(commandBuffer, draws.instances->getBuffer(),
+												 VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+												 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+												 VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+	}
+
+	void ReaShaderRenderer::recordPostProcessPass(
+		VkCommandBuffer commandBuffer, vkt::Rendering::Material* material, vkt::Descriptors::DescriptorSet inputSet,
+		vkt::RenderGraph::Resource target, std::array<vkt::RenderGraph::Resource, 1 + MAX_POST_PROCESS_INPUTS> inputs,
+		VkExtent2D extent, double pushConstants[])
+	{
+		// the set of this pass in the slot, the previous use of the slot has completed
+
+		std::array<VkDescriptorImageInfo, 1 + MAX_POST_PROCESS_INPUTS> imageInfos;
+		for (size_t i = 0; i < inputs.size(); i++)
+			imageInfos[i] = { vkSampler, renderGraph->getImageView(inputs[i]),
+							  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+		VkWriteDescriptorSet inputsWrite{};
+		inputsWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		inputsWrite.dstSet = inputSet.set;
+		inputsWrite.dstBinding = defaultIds::descriptorBindings::post_process_inputs;
+		inputsWrite.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+		inputsWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		inputsWrite.pImageInfo = imageInfos.data();
+		vkUpdateDescriptorSets(vktDevice->vk(), 1, &inputsWrite, 0, nullptr);
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = postProcessChain.renderPass;
+		renderPassInfo.framebuffer = renderGraph->getFramebuffer(postProcessChain.renderPass, { target });
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = extent;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		// same mapping as the objects, so every pass keeps the frame upright
+
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = static_cast<float>(extent.height);
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = -static_cast<float>(extent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor{};
+		scissor.offset = { 0, 0 };
+		scissor.extent = extent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipeline);
+		material->cmdBindDescriptors(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 1, 1,
+								&inputSet.set, 0, nullptr);
+
+		DefaultPushConstants constants{};
+		constants.objectId = 0;
+		constants.videoParam = pushConstants[2];
+		constants.inputCount = static_cast<glm::int32>(getCurrentFrameSlot().inputCount);
+		material->cmdPushConstants(commandBuffer, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+								   &constants, 0);
+
+		vkt::Rendering::Mesh* quad = *meshes.get(defaultIds::meshes::quad);
+		VkDeviceSize offset = 0;
+		VkBuffer vertexBuffer = quad->getVertexBuffer()->getBuffer();
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+		vkCmdDraw(commandBuffer, static_cast<uint32_t>(quad->getVertices().size()), 1, 0, 0);
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	void ReaShaderRenderer::recordPostProcessDispatch(
+		VkCommandBuffer commandBuffer, vkt::Rendering::Material* material, vkt::Descriptors::DescriptorSet computeSet,
+		vkt::RenderGraph::Resource target, std::array<vkt::RenderGraph::Resource, 1 + MAX_POST_PROCESS_INPUTS> inputs,
+		VkExtent2D extent, double pushConstants[])
+	{
+		// the set of this pass in the slot, the previous use of the slot has completed
 
-		// submit ( end command buffer )
+		std::array<VkDescriptorImageInfo, 1 + MAX_POST_PROCESS_INPUTS> imageInfos;
+		for (size_t i = 0; i < inputs.size(); i++)
+			imageInfos[i] = { vkSampler, renderGraph->getImageView(inputs[i]),
+							  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		VkDescriptorImageInfo targetInfo{ VK_NULL_HANDLE, renderGraph->getImageView(target), VK_IMAGE_LAYOUT_GENERAL };
 
-		commandPool->submit(commandBuffer, VK_NULL_HANDLE, vkRenderFinishedSemaphore, vkImageAvailableSemaphore);
+		std::array<VkWriteDescriptorSet, 2> writes{};
+		for (VkWriteDescriptorSet& write : writes)
+		{
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = computeSet.set;
+		}
+		writes[0].dstBinding = defaultIds::descriptorBindings::post_process_inputs;
+		writes[0].descriptorCount = static_cast<uint32_t>(imageInfos.size());
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[0].pImageInfo = imageInfos.data();
+		writes[1].dstBinding = defaultIds::descriptorBindings::post_process_target;
+		writes[1].descriptorCount = 1;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[1].pImageInfo = &targetInfo;
+		vkUpdateDescriptorSets(vktDevice->vk(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, material->pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, material->pipelineLayout, 0, 1,
+								&computeSet.set, 0, nullptr);
+
+		DefaultPushConstants constants{};
+		constants.objectId = 0;
+		constants.videoParam = pushConstants[2];
+		constants.inputCount = static_cast<glm::int32>(getCurrentFrameSlot().inputCount);
+		material->cmdPushConstants(commandBuffer, VK_SHADER_STAGE_COMPUTE_BIT, &constants, 0);
+
+		material->cmdDispatch(commandBuffer, extent.width, extent.height);
 	}
 
-	void ReaShaderRenderer::transferFrame(int*& destBuffer)
+	void ReaShaderRenderer::drawFrame(double pushConstants[])
 	{
 		if (halted)
 			return;
 
+		FrameSlot& frameSlot = getCurrentFrameSlot();
+
+		vkt::Queue* queue = vktDevice->getGraphicsQueue();
+
+		// drawn at the scale chosen by loadBitsToImage
+		VkExtent2D extent = getScaledExtent(frameSlot.scaleLevel);
+
+		// begin command buffer
+		VkCommandBuffer commandBuffer = frameSlot.frameContext->createCommandBuffer(queue);
+
+		// gpu time of the draw, drives the adaptive resolution
+
+		bool timed = adaptiveResolution.enabled && adaptiveResolution.supported;
+		uint32_t firstQuery = currentFrameSlot * 2;
+
+		if (timed)
+		{
+			adaptiveResolution.frameBudgetMs = pushConstants[1] > 0 ? 1000.0 / pushConstants[1] : 0.0;
+
+			vkCmdResetQueryPool(commandBuffer, adaptiveResolution.queryPool, firstQuery, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, adaptiveResolution.queryPool,
+								firstQuery);
+		}
+
+		// camera and objects of the virtual scene, the objects are culled on the gpu into the draws of the slot
+
+		updateVirtualScene(pushConstants);
+		prepareSceneDraws(frameSlot);
+
+		// the slot was waited for by the load, the transients of the older frames can go
+		renderGraph->releaseUnused(TRANSIENT_IDLE_FRAMES);
+
+		// the color attachment was last read by the readback, the yuv encode or the next instance, the ingest left
+		// the post process source sampled
+
+		vkt::RenderGraph::Resource color = renderGraph->importImage(
+			vktColorAttachment, { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+								  VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0 });
+		vkt::RenderGraph::Resource postProcessSource =
+			renderGraph->importImage(vktPostProcessSource, { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+															 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+															 VK_ACCESS_SHADER_READ_BIT });
+
+		// the depth (and the color at a reduced scale) only live in the frame, their memory is shared
+
+		vkt::RenderGraph::Resource sceneColor =
+			frameSlot.scaleLevel ? renderGraph->createImage(extent, vktColorAttachment->getFormat()) : color;
+		vkt::RenderGraph::Resource depth = renderGraph->createImage(extent, VK_FORMAT_D32_SFLOAT);
+
+		// post process chain, each pass samples the output of the previous one (the ingested frame for the first) and
+		// writes the next of two ping-pong targets or a named intermediate, the last one draws into the scene color
+		// (compute passes write a storage image of their own, blitted into the scene color if last)
+
+		std::array<vkt::RenderGraph::Resource, 2> pingPong{
+			renderGraph->createImage(extent, vktColorAttachment->getFormat()),
+			renderGraph->createImage(extent, vktColorAttachment->getFormat())
+		};
+		uint32_t nextPingPong = 0;
+		std::map<std::string, vkt::RenderGraph::Resource> intermediates;
+		vkt::RenderGraph::Resource previous = postProcessSource;
+
+		for (size_t i = 0; i < postProcessChain.passes.size(); i++)
+		{
+			const PostProcessPass& pass = postProcessChain.passes[i];
+
+			if (pass.compute && !postProcessChain.computeSupported)
+				continue;
+
+			vkt::RenderGraph::Resource target;
+			if (pass.compute)
+				target = renderGraph->createImage(extent, VK_FORMAT_R8G8B8A8_UNORM);
+			else if (i + 1 == postProcessChain.passes.size())
+				target = sceneColor;
+			else if (!pass.output.empty())
+				target = renderGraph->createImage(extent, vktColorAttachment->getFormat());
+			else
+			{
+				target = pingPong[nextPingPong];
+				nextPingPong ^= 1;
+			}
+			if (!pass.output.empty())
+				intermediates[pass.output] = target;
+
+			// unused bindings (and unknown names) sample the ingested frame
+			std::array<vkt::RenderGraph::Resource, 1 + MAX_POST_PROCESS_INPUTS> inputs;
+			inputs.fill(postProcessSource);
+			inputs[0] = previous;
+			for (size_t j = 0; j < pass.inputs.size(); j++)
+			{
+				auto intermediate = intermediates.find(pass.inputs[j]);
+				if (intermediate != intermediates.end())
+					inputs[1 + j] = intermediate->second;
+			}
+
+			vkt::Rendering::Material* material = getPostProcessMaterial(pass);
+
+			if (pass.compute)
+			{
+				vkt::Descriptors::DescriptorSet computeSet = frameSlot.postProcessComputeSets[i];
+
+				vkt::RenderGraph::Pass& graphPass = renderGraph->addPass(
+					"post process " + std::to_string(i), [=, this](VkCommandBuffer commandBuffer) {
+						recordPostProcessDispatch(commandBuffer, material, computeSet, target, inputs, extent,
+												  pushConstants);
+					});
+				graphPass.write(target, vkt::RenderGraph::Usage::StorageWrite);
+				for (vkt::RenderGraph::Resource input : inputs)
+					graphPass.read(input, vkt::RenderGraph::Usage::ComputeSampled);
+			}
+			else
+			{
+				vkt::Descriptors::DescriptorSet inputSet = frameSlot.postProcessInputSets[i];
+
+				vkt::RenderGraph::Pass& graphPass = renderGraph->addPass(
+					"post process " + std::to_string(i), [=, this](VkCommandBuffer commandBuffer) {
+						recordPostProcessPass(commandBuffer, material, inputSet, target, inputs, extent,
+											  pushConstants);
+					});
+				graphPass.write(target, vkt::RenderGraph::Usage::ColorAttachment);
+				for (vkt::RenderGraph::Resource input : inputs)
+					graphPass.read(input, vkt::RenderGraph::Usage::Sampled);
+			}
+
+			previous = target;
+		}
+
+		// the chain ended with a compute pass (or skipped it)
+
+		if (previous != sceneColor)
+			renderGraph
+				->addPass("post process resolve",
+						  [=, this](VkCommandBuffer commandBuffer) {
+							  vkt::commands::blitImage(commandBuffer, renderGraph->getImage(previous),
+													   renderGraph->getExtent(previous),
+													   renderGraph->getImage(sceneColor), extent, VK_FILTER_LINEAR);
+						  })
+				.read(previous, vkt::RenderGraph::Usage::TransferSrc)
+				.write(sceneColor, vkt::RenderGraph::Usage::TransferDst);
+
+		if (scene.supported && !scene.batches.empty())
+			renderGraph
+				->addPass("cull",
+						  [&](VkCommandBuffer commandBuffer) { recordCulling(commandBuffer, frameSlot, pushConstants); })
+				.sideEffects();
+
+		renderGraph
+			->addPass("scene",
+					  [&](VkCommandBuffer commandBuffer) {
+						  recordScene(commandBuffer, renderGraph->getFramebuffer(vkRenderPass, { sceneColor, depth }),
+									  extent, pushConstants);
+					  })
+			.read(postProcessSource, vkt::RenderGraph::Usage::Sampled)
+			.modify(sceneColor, vkt::RenderGraph::Usage::ColorAttachment)
+			.write(depth, vkt::RenderGraph::Usage::DepthAttachment);
+
+		// drawn at a reduced scale, upscale into the color attachment (which is read back)
+
+		if (frameSlot.scaleLevel)
+			renderGraph
+				->addPass("upscale",
+						  [&](VkCommandBuffer commandBuffer) {
+							  vkt::commands::copyOrBlitImage(commandBuffer, renderGraph->getImage(sceneColor), extent,
+															 vktColorAttachment->getImage(), { FRAME_W, FRAME_H },
+															 VK_FILTER_LINEAR);
+						  })
+				.read(sceneColor, vkt::RenderGraph::Usage::TransferSrc)
+				.write(color, vkt::RenderGraph::Usage::TransferDst);
+
+		// read back (copy), yuv encoded (sampled) or copied by the next instance
+
+		renderGraph->exportImage(color, { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+										  VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+										  VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT });
+
+		renderGraph->execute(commandBuffer);
+
+		if (timed)
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, adaptiveResolution.queryPool,
+								firstQuery + 1);
+		frameSlot.timed = timed;
+
+		// hand the post process source to the transfer queue, so the next upload can keep the unchanged tiles (the
+		// graph is on one queue, ownership transfers are written here)
+
+		if (frameIOPaths.transferQueue && !frameIOPaths.hostImageCopy)
+		{
+			vkt::commands::insertImageMemoryBarrier(
+				commandBuffer, vktPostProcessSource->getImage(), 0, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+				vktDevice->getGraphicsQueue()->getFamilyIndex(), vktDevice->getTransferQueue()->getFamilyIndex());
+
+			postProcessSourceOnTransfer = true;
+		}
+
+		// submit ( end command buffer ), wait for the upload of this slot
+
+		frameSlot.rendered = frameSlot.frameContext->submit(queue, commandBuffer, { { frameSlot.uploaded } });
+	}
+
+	int ReaShaderRenderer::submitReadback(int* destBuffer, int fmt, int rowspan)
+	{
+		if (halted)
+			return -1;
+
 		// init command buffer
 
-		VkCommandBuffer commandBuffer = vkTransferCommandBuffer;
-		vkt::CommandPool* commandPool = vktDevice->getGraphicsCommandPool();
+		uint32_t slot = currentFrameSlot;
+		FrameSlot& frameSlot = getCurrentFrameSlot();
 
-		VK_CHECK_RESULT(vkQueueWaitIdle(vktDevice->getGraphicsQueue()->vk()));
+		VkExtent2D extent{ FRAME_W, FRAME_H };
 
-		commandPool->restartCommandBuffer(commandBuffer);
+		bool yuv = fmt == 'YV12' || fmt == 'YUY2';
 
-		// Transition destination image to transfer destination layout
+		// rows of the destination frame, tightly packed if not given
+		size_t rowBytes = yuv ? yuvEncodedExtent(fmt, FRAME_W, FRAME_H).width : sizeof(LICE_pixel) * FRAME_W;
+		if (rowspan <= 0)
+			rowspan = static_cast<int>(rowBytes);
+		size_t frameSize = (size_t)rowspan * FRAME_H;
 
-		vkt::commands::insertImageMemoryBarrier(
-			commandBuffer, vktFrameTransfer->getImage(), 0, VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT, VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+		// the output frame gets its own import (the ingest one may still be read by the upload), buffer image copies
+		// need a texel aligned offset and row length
+
+		bool imported = !yuv && frameIOPaths.importHostMemory && rowspan % sizeof(LICE_pixel) == 0 &&
+						frameSlot.vktImportedOutputFrame->import(destBuffer, frameSize,
+																 VK_BUFFER_USAGE_TRANSFER_DST_BIT) &&
+						frameSlot.vktImportedOutputFrame->getOffset() % sizeof(LICE_pixel) == 0;
+
+		// plain copies run on the dedicated transfer queue (the yuv encode needs the graphics queue)
+
+		bool onTransferQueue = frameIOPaths.transferQueue && !yuv;
+
+		uint32_t graphicsFamily = vktDevice->getGraphicsQueue()->getFamilyIndex();
+		uint32_t transferFamily = vktDevice->getTransferQueue()->getFamilyIndex();
+
+		// ordered after drawFrame
+		vkt::TimelinePoint waitPoint = frameSlot.rendered;
 
-		// srcImage is already in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, and does not need to be transitioned
-
-		// do the blit/copy
-
-		// If source and destination support blit we'll blit as this also does automatic format conversion (e.g. from
-		// BGR to RGB)
-		if (vktDevice->physicalDevice->supportsBlit())
-		{
-			// Define the region to blit (we will blit the whole swapchain image)
-			VkOffset3D blitSize{};
-			blitSize.x = FRAME_W;
-			blitSize.y = FRAME_H;
-			blitSize.z = 1;
-			VkImageBlit imageBlitRegion{};
-			imageBlitRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlitRegion.srcSubresource.layerCount = 1;
-			imageBlitRegion.srcOffsets[1] = blitSize;
-			imageBlitRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlitRegion.dstSubresource.layerCount = 1;
-			imageBlitRegion.dstOffsets[1] = blitSize;
-
-			// Issue the blit command
-			vkCmdBlitImage(commandBuffer, vktColorAttachment->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-						   vktFrameTransfer->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlitRegion,
-						   VK_FILTER_NEAREST);
+		if (onTransferQueue)
+		{
+			// the graphics queue releases the color attachment to the transfer queue once the draw is done
+
+			VkCommandBuffer releaseCommandBuffer =
+				frameSlot.frameContext->createCommandBuffer(vktDevice->getGraphicsQueue());
+
+			vkt::commands::insertImageMemoryBarrier(
+				releaseCommandBuffer, vktColorAttachment->getImage(), 0, 0, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, graphicsFamily, transferFamily);
+
+			waitPoint = frameSlot.frameContext->submit(vktDevice->getGraphicsQueue(), releaseCommandBuffer,
+													   { { waitPoint, VK_PIPELINE_STAGE_TRANSFER_BIT } });
 		}
-		else
+
+		vkt::Queue* queue = onTransferQueue ? vktDevice->getTransferQueue() : vktDevice->getGraphicsQueue();
+		VkCommandBuffer commandBuffer = frameSlot.frameContext->createCommandBuffer(queue);
+
+		if (onTransferQueue)
 		{
-			// Otherwise use image copy (requires us to manually flip components)
-			VkImageCopy imageCopyRegion{};
-			imageCopyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageCopyRegion.srcSubresource.layerCount = 1;
-			imageCopyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageCopyRegion.dstSubresource.layerCount = 1;
-			imageCopyRegion.extent = { FRAME_W, FRAME_H };
-			imageCopyRegion.extent.depth = 1;
-
-			// Issue the copy command
-			vkCmdCopyImage(commandBuffer, vktColorAttachment->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-						   vktFrameTransfer->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopyRegion);
+			// acquire (same barrier as the release)
+
+			vkt::commands::insertImageMemoryBarrier(
+				commandBuffer, vktColorAttachment->getImage(), 0, VK_ACCESS_TRANSFER_READ_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, graphicsFamily, transferFamily);
 		}
 
-		// Transition destination image to general layout, which is the required layout for mapping the image memory
-		// later on
-		vkt::commands::insertImageMemoryBarrier(
-			commandBuffer, vktFrameTransfer->getImage(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT, VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+		if (yuv)
+		{
+			VkExtent2D encodedExtent = yuvEncodedExtent(fmt, FRAME_W, FRAME_H);
+
+			// rendered frame goes shader read optimal
+
+			vkt::commands::insertImageMemoryBarrier(
+				commandBuffer, vktColorAttachment->getImage(), VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+
+			vkt::Descriptors::DescriptorSetWriter(vktDevice)
+				.selectDescriptorSet(yuvEncode.sourceSet)
+				.selectBinding(defaultIds::descriptorBindings::rendered_frame)
+				.registerWriteImage(vktColorAttachment, vkSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+				.writeRegistered();
+
+			// encode the planes (color conversion and chroma subsampling), only the bytes of the requested format
+
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = yuvEncode.renderPass;
+			renderPassInfo.framebuffer = yuvEncode.framebuffer;
+			renderPassInfo.renderArea.offset = { 0, 0 };
+			renderPassInfo.renderArea.extent = encodedExtent;
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport{};
+			viewport.width = static_cast<float>(encodedExtent.width);
+			viewport.height = static_cast<float>(encodedExtent.height);
+			viewport.maxDepth = 1.0f;
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+			VkRect2D scissor{};
+			scissor.extent = encodedExtent;
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			vkt::Rendering::Material* material = materials.get(defaultIds::materials::rgb_to_yuv);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipeline);
+			material->cmdBindDescriptors(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+			YuvPushConstants constants{};
+			constants.format = fmt == 'YV12' ? 0 : 1;
+			constants.matrix = yuvUsesBT709() ? 1 : 0;
+			constants.width = FRAME_W;
+			constants.height = FRAME_H;
+			material->cmdPushConstants(commandBuffer, VK_SHADER_STAGE_FRAGMENT_BIT, &constants, 0);
+
+			vkt::Rendering::Mesh* quad = *meshes.get(defaultIds::meshes::quad);
+			VkDeviceSize offset = 0;
+			VkBuffer vertexBuffer = quad->getVertexBuffer()->getBuffer();
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+			vkCmdDraw(commandBuffer, static_cast<uint32_t>(quad->getVertices().size()), 1, 0, 0);
+
+			// encode target is now transfer src optimal
+
+			vkCmdEndRenderPass(commandBuffer);
+
+			vkt::commands::copyImageToBuffer(commandBuffer, yuvEncode.target->getImage(),
+											 frameSlot.vktReadback->getBuffer(), 0, encodedExtent);
+
+			// make the writes available to the host
+
+			vkt::commands::insertBufferMemoryBarrier(commandBuffer, frameSlot.vktReadback->getBuffer(),
+													 VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+													 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+		}
+		else if (imported)
+		{
+			// the gpu writes the video frame bits directly (raw copy, like the image copy path below)
+
+			// srcImage is already in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, and does not need to be transitioned
+
+			vkt::commands::copyImageToBuffer(commandBuffer, vktColorAttachment->getImage(),
+											 frameSlot.vktImportedOutputFrame->getBuffer(),
+											 frameSlot.vktImportedOutputFrame->getOffset(), extent,
+											 rowspan / sizeof(LICE_pixel));
+
+			// make the writes available to the host
+
+			vkt::commands::insertBufferMemoryBarrier(commandBuffer, frameSlot.vktImportedOutputFrame->getBuffer(),
+													 VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+													 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+		}
+		else
+		{
+			frameSlot.vktImportedOutputFrame->release();
+
+			// tightly packed rows into the readback buffer (raw copy, same format), no linear image to blit into
+
+			// srcImage is already in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, and does not need to be transitioned
+
+			vkt::commands::copyImageToBuffer(commandBuffer, vktColorAttachment->getImage(),
+											 frameSlot.vktReadback->getBuffer(), 0, extent);
+
+			// make the writes available to the host
+
+			vkt::commands::insertBufferMemoryBarrier(commandBuffer, frameSlot.vktReadback->getBuffer(),
+													 VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+													 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+		}
 
 		// submit queue (wait for draw frame)
 
-		commandPool->submit(commandBuffer, vkInFlightFence, VK_NULL_HANDLE, vkRenderFinishedSemaphore);
+		frameSlot.readBack =
+			frameSlot.frameContext->submit(queue, commandBuffer, { { waitPoint, VK_PIPELINE_STAGE_TRANSFER_BIT } });
 
-		// wait fence since now we are on cpu
+		frameSlot.pendingReadback = { destBuffer, fmt, rowspan, imported, true };
 
-		VK_CHECK_RESULT(vkWaitForFences(vktDevice->vk(), 1, &vkInFlightFence, VK_TRUE, UINT64_MAX))
-		VK_CHECK_RESULT(vkResetFences(vktDevice->vk(), 1, &vkInFlightFence))
+		// next frame goes to the next slot
 
-		// Get layout of the image (including row pitch)
-		VkImageSubresource subResource{};
-		subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		VkSubresourceLayout subResourceLayout;
+		currentFrameSlot = (currentFrameSlot + 1) % FRAMES_IN_FLIGHT;
 
-		vkGetImageSubresourceLayout(vktDevice->vk(), vktFrameTransfer->getImage(), &subResource, &subResourceLayout);
+		return static_cast<int>(slot);
+	}
 
-		// dest image is already mapped
-		memcpy((void*)destBuffer,
-			   (void*)(reinterpret_cast<uintptr_t>((vktFrameTransfer->getAllocationInfo()).pMappedData) +
-					   subResourceLayout.offset),
-			   sizeof(LICE_pixel) * FRAME_W * FRAME_H);
+	bool ReaShaderRenderer::isReadbackReady(int slot)
+	{
+		// the timeline value is read, not waited for
+		return slot < 0 || !frameSlots[slot].pendingReadback.pending || frameSlots[slot].readBack.reached();
 	}
 
-	// load vf bits to color attachment
-	void ReaShaderRenderer::loadBitsToImage(int* srcBuffer)
+	void ReaShaderRenderer::finishReadback(int slot)
 	{
-		if (halted)
+		if (slot < 0 || !frameSlots[slot].pendingReadback.pending)
 			return;
 
-		vkt::CommandPool* commandPool = vktDevice->getGraphicsCommandPool();
+		FrameSlot& frameSlot = frameSlots[slot];
+		FrameSlot::PendingReadback& readback = frameSlot.pendingReadback;
+		readback.pending = false;
+
+		// wait only for this slot since now we are on cpu (the exact value, not the whole queue)
+
+		frameSlot.readBack.wait();
+
+		updateRenderScale(static_cast<uint32_t>(slot));
+
+		// the gpu is done with the video frames, they may be released by reaper after we return
+
+		frameSlot.vktImportedFrame->release();
+		frameSlot.vktImportedOutputFrame->release();
+
+		if (readback.imported)
+			return;
+
+		// the readback buffer is persistently mapped (host cached, so invalidate)
+
+		VK_CHECK_RESULT(
+			vmaInvalidateAllocation(vktDevice->vmaAllocator, frameSlot.vktReadback->getAllocation(), 0, VK_WHOLE_SIZE))
+
+		const uint8_t* mapped = (const uint8_t*)frameSlot.vktReadback->getMappedData();
+
+		if (readback.fmt == 'YV12' || readback.fmt == 'YUY2')
+		{
+			unpackYuvPlanes((uint8_t*)readback.destBuffer, mapped, readback.fmt, FRAME_W, FRAME_H, readback.rowspan);
+		}
+		else
+		{
+			// rows are tightly packed in the buffer and rowspan apart in the frame
+			size_t rowBytes = sizeof(LICE_pixel) * FRAME_W;
+			copyRows((uint8_t*)readback.destBuffer, readback.rowspan, mapped, rowBytes, rowBytes, FRAME_H);
+		}
+	}
+
+	bool ReaShaderRenderer::transferFrame(int*& destBuffer, int fmt, int rowspan)
+	{
+		int slot = submitReadback(destBuffer, fmt, rowspan);
+		if (slot < 0)
+			return false;
+
+		finishReadback(slot);
+		return true;
+	}
+
+	/* frame hand-off */
+
+	void ReaShaderRenderer::retireHandedOffFrame()
+	{
+		FrameHandoff::Frame frame = FrameHandoff::retire(this);
+
+		// a frame is handed off only when it goes straight to an instance that copied the last one, which resolves it
+		handOffConsumer = frame.claimedBy;
+		handOffConsumed = frame.consumed;
+	}
+
+	bool ReaShaderRenderer::claimHandedOffFrame(const int* srcBuffer)
+	{
+		handedInFrame = {};
+
+		if (halted)
+			return false;
+
+		return FrameHandoff::claim(srcBuffer, this, sharedDevice, static_cast<int>(FRAME_W),
+								   static_cast<int>(FRAME_H), handedInFrame);
+	}
+
+	bool ReaShaderRenderer::loadHandedOffFrame()
+	{
+		if (halted || !handedInFrame.image)
+			return false;
+
+		FrameSlot& frameSlot = getCurrentFrameSlot();
+
 		vkt::Queue* queue = vktDevice->getGraphicsQueue();
-		VkCommandBuffer commandBuffer = vkTransferCommandBuffer;
 
-		VK_CHECK_RESULT(vkQueueWaitIdle(queue->vk()))
+		// same slot reuse as loadBitsToImage
 
-		commandPool->restartCommandBuffer(vkTransferCommandBuffer);
+		finishReadback(static_cast<int>(currentFrameSlot));
+		frameSlot.readBack.wait();
+		frameSlot.frameContext->reset();
+		updateRenderScale(currentFrameSlot);
 
-		vkt::commands::transferRawBufferToImage(vktDevice, commandBuffer, srcBuffer, vktFrameTransfer,
-												sizeof(LICE_pixel) * FRAME_W * FRAME_H);
+		frameSlot.vktImportedFrame->release();
 
-		// retransition frametransfer to src copy optimal
+		VkCommandBuffer commandBuffer = frameSlot.frameContext->createCommandBuffer(queue);
 
-		vkt::commands::insertImageMemoryBarrier(vkTransferCommandBuffer, vktFrameTransfer->getImage(),
-												VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT,
-												VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-												VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-												VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+		VkExtent2D extent{ FRAME_W, FRAME_H };
 
-		// color attachment goes dst optimal
+		frameSlot.scaleLevel = adaptiveResolution.enabled && adaptiveResolution.supported && !adaptiveResolution.offline
+								   ? adaptiveResolution.level
+								   : 0;
+		lastRenderScale = renderScaleLevels[frameSlot.scaleLevel];
 
-		vkt::commands::insertImageMemoryBarrier(
-			vkTransferCommandBuffer, vktColorAttachment->getImage(), 0, VK_ACCESS_MEMORY_READ_BIT,
-			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT, VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+		// the whole post process source is replaced, its contents (and queue family) don't matter
 
-		// as well as post process source
+		dirtyTiles.invalidate();
+		postProcessSourceOnTransfer = false;
 
 		vkt::commands::insertImageMemoryBarrier(
-			vkTransferCommandBuffer, vktPostProcessSource->getImage(), 0, VK_ACCESS_MEMORY_READ_BIT,
+			commandBuffer, vktPostProcessSource->getImage(), 0, VK_ACCESS_TRANSFER_WRITE_BIT,
 			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_PIPELINE_STAGE_TRANSFER_BIT, VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
 
-		// perform copy to color attachment
+		// the rendered frame of the previous instance (device local copy, waited for at submit)
 
-		VkImageCopy imageCopyRegion{};
-		imageCopyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		imageCopyRegion.srcSubresource.layerCount = 1;
-		imageCopyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		imageCopyRegion.dstSubresource.layerCount = 1;
-		imageCopyRegion.extent.width = FRAME_W;
-		imageCopyRegion.extent.height = FRAME_H;
-		imageCopyRegion.extent.depth = 1;
+		vkt::commands::copyOrBlitImage(commandBuffer, handedInFrame.image->getImage(), extent,
+									   vktPostProcessSource->getImage(), extent);
 
-		vkCmdCopyImage(vkTransferCommandBuffer, vktFrameTransfer->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-					   vktColorAttachment->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopyRegion);
+		// post process source goes src optimal
 
-		// and to post process source
+		vkt::commands::insertImageMemoryBarrier(
+			commandBuffer, vktPostProcessSource->getImage(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
 
-		vkCmdCopyImage(vkTransferCommandBuffer, vktFrameTransfer->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-					   vktPostProcessSource->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopyRegion);
+		recordInputLayers(commandBuffer, frameSlot);
 
 		// retransition post process source to shader read optimal
 
-		vkt::commands::insertImageMemoryBarrier(vkTransferCommandBuffer, vktPostProcessSource->getImage(), 0,
-												VK_ACCESS_MEMORY_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-												VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-												VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		vkt::commands::insertImageMemoryBarrier(commandBuffer, vktPostProcessSource->getImage(),
+												VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+												VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+												VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+												VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 												VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
 
-		commandPool->submit(vkTransferCommandBuffer, vkInFlightFence, vkImageAvailableSemaphore, VK_NULL_HANDLE);
+		// after the draw of the previous instance, the producer waits for this before drawing again
 
-		// write descriptor for post process source
+		frameSlot.uploaded = frameSlot.frameContext->submit(
+			queue, commandBuffer,
+			{ { handedInFrame.rendered, VK_PIPELINE_STAGE_TRANSFER_BIT },
+			  { handOffConsumed, VK_PIPELINE_STAGE_TRANSFER_BIT } });
 
-		VK_CHECK_RESULT(vkWaitForFences(vktDevice->vk(), 1, &vkInFlightFence, VK_TRUE, UINT64_MAX))
-		VK_CHECK_RESULT(vkResetFences(vktDevice->vk(), 1, &vkInFlightFence))
+		FrameHandoff::consume(handedInFrame.bits, frameSlot.uploaded);
+		handedInFrame = {};
 
-		vkt::Descriptors::DescriptorSetWriter(vktDevice)
-			.selectDescriptorSet(virtualSceneData.textureSet)
-			.selectBinding(defaultIds::descriptorBindings::sampled_frame)
-			.registerWriteImage(vktPostProcessSource, vkSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-			.writeRegistered();
+		return true;
+	}
+
+	bool ReaShaderRenderer::handOffFrame(IVideoFrame* frame)
+	{
+		if (halted)
+			return false;
+
+		int* destBuffer = frame->get_bits();
+		int rowspan = frame->get_rowspan();
+
+		FrameSlot& frameSlot = getCurrentFrameSlot();
+
+		// the color attachment stays as the draw left it, a consumer that needs the bits reads it back through us
+
+		vkt::TimelinePoint rendered = frameSlot.rendered;
+
+		FrameHandoff::publish({ frame, destBuffer, static_cast<int>(FRAME_W), static_cast<int>(FRAME_H), sharedDevice,
+								this, vktColorAttachment, rendered,
+								[=]() { readBackHandedOffFrame(destBuffer, rowspan, rendered); } });
+
+		// the slot is done once the draw is (no readback to finish), next frame goes to the next slot
+
+		frameSlot.readBack = rendered;
+		frameSlot.pendingReadback = {};
+
+		currentFrameSlot = (currentFrameSlot + 1) % FRAMES_IN_FLIGHT;
+
+		return true;
+	}
+
+	void ReaShaderRenderer::publishFrame(IVideoFrame* frame, int slot)
+	{
+		if (halted || slot < 0)
+			return;
+
+		// already read back, the image goes along for a consumer on this device (the bits are valid for the others)
+
+		FrameHandoff::publish({ frame, frame->get_bits(), static_cast<int>(FRAME_W), static_cast<int>(FRAME_H),
+								sharedDevice, this, vktColorAttachment, frameSlots[slot].rendered });
+	}
+
+	void ReaShaderRenderer::readBackHandedOffFrame(int* destBuffer, int rowspan, vkt::TimelinePoint rendered)
+	{
+		// the producer is done with its frame, but may be driven again meanwhile (another track)
+		std::lock_guard<std::mutex> lock(frameMutex);
+
+		if (halted)
+			return;
+
+		// nothing was drawn since the hand-off, the current slot reads back the color attachment after that draw
+
+		FrameSlot& frameSlot = getCurrentFrameSlot();
+
+		finishReadback(static_cast<int>(currentFrameSlot));
+		frameSlot.readBack.wait();
+		frameSlot.frameContext->reset();
+		updateRenderScale(currentFrameSlot);
+
+		frameSlot.rendered = rendered;
+		frameSlot.timed = false;
+
+		transferFrame(destBuffer, 'RGBA', rowspan);
+	}
+
+	void ReaShaderRenderer::setPostProcessChain(std::vector<PostProcessPass> passes)
+	{
+		// runs of per pixel snippets become one pass, named by the snippets it applies in order
+
+		std::vector<PostProcessPass> fused;
+		int frameInputs = 0;
+		for (PostProcessPass& pass : passes)
+		{
+			if (pass.inputs.size() > MAX_POST_PROCESS_INPUTS)
+				throw std::runtime_error("too many post process pass inputs!");
+
+			if (pass.frameInputs < 0 || pass.frameInputs > MAX_FRAME_INPUTS - 1)
+				throw std::runtime_error("too many post process pass frame inputs!");
+			frameInputs = std::max(frameInputs, pass.frameInputs);
+
+			// the snippets only see the color of the previous one, the intermediates would be silently dropped
+			if (pass.pixel && !pass.inputs.empty())
+				throw std::runtime_error("per pixel post process passes can't have inputs!");
+
+			bool fusable = pass.pixel && !pass.compute;
+			if (fusable && !fused.empty() && fused.back().pixel && !fused.back().compute && fused.back().output.empty())
+			{
+				fused.back().shader += "+" + pass.shader;
+				fused.back().output = pass.output;
+				fused.back().frameInputs = std::max(fused.back().frameInputs, pass.frameInputs);
+				continue;
+			}
+
+			fused.push_back(std::move(pass));
+		}
+
+		if (fused.size() > MAX_POST_PROCESS_PASSES)
+			throw std::runtime_error("too many post process passes!");
+
+		if (fused.empty())
+			fused.push_back({ "pp_frag.glsl" });
+
+		postProcessChain.passes = std::move(fused);
+		postProcessChain.frameInputs = frameInputs;
+	}
+
+	void ReaShaderRenderer::setFrameInputs(const FrameInput* inputs, int count)
+	{
+		pendingInputCount = static_cast<uint32_t>(std::clamp(count, 0, MAX_FRAME_INPUTS - 1));
+		std::copy(inputs, inputs + pendingInputCount, pendingInputs.begin());
+	}
+
+	// load vf bits to color attachment
+	bool ReaShaderRenderer::loadBitsToImage(int* srcBuffer, int fmt, int rowspan)
+	{
+		if (halted)
+			return false;
+
+		FrameSlot& frameSlot = getCurrentFrameSlot();
+		vkt::Images::AllocatedImage* vktFrameTransfer = frameSlot.vktFrameTransfer;
+
+		vkt::Queue* queue = vktDevice->getGraphicsQueue();
+
+		// only wait for the previous use of this slot, not for the whole queue (copies out a readback the caller
+		// didn't finish), then its command buffers are reset all at once
+
+		finishReadback(static_cast<int>(currentFrameSlot));
+		frameSlot.readBack.wait();
+		frameSlot.frameContext->reset();
+
+		// handed off frames skip finishReadback
+		updateRenderScale(currentFrameSlot);
+
+		// drop the host memory imported by the previous use of this slot
+
+		frameSlot.vktImportedFrame->release();
+
+		// signaled by the transfer queue copies, empty if the upload is all on the graphics queue
+		vkt::TimelinePoint uploadTransferred{};
+
+		VkCommandBuffer commandBuffer = frameSlot.frameContext->createCommandBuffer(queue);
+
+		VkExtent2D extent{ FRAME_W, FRAME_H };
+
+		// rgba rows, tightly packed if not given
+		size_t frameRowspan = rowspan > 0 ? rowspan : sizeof(LICE_pixel) * FRAME_W;
+		size_t frameSize = frameRowspan * FRAME_H;
+
+		// the effects of this frame are drawn at this scale (adaptive resolution), the post process pass samples the
+		// frame into the target of that scale
+
+		frameSlot.scaleLevel = adaptiveResolution.enabled && adaptiveResolution.supported && !adaptiveResolution.offline
+								   ? adaptiveResolution.level
+								   : 0;
+		lastRenderScale = renderScaleLevels[frameSlot.scaleLevel];
+
+		if (fmt == 'YV12' || fmt == 'YUY2')
+		{
+			frameSlot.vktImportedFrame->release();
+
+			// the whole post process source is redrawn, the next rgba frame can't be compared with it
+			dirtyTiles.invalidate();
+
+			// upload the planes as they are (no reaper side rgb conversion)
+
+			packYuvPlanes((uint8_t*)frameSlot.vktYuvPlanes->getMappedData(), (const uint8_t*)srcBuffer, fmt, FRAME_W,
+						  FRAME_H, rowspan);
+			VK_CHECK_RESULT(
+				vmaFlushAllocation(vktDevice->vmaAllocator, frameSlot.vktYuvPlanes->getAllocation(), 0, VK_WHOLE_SIZE))
+
+			vkt::Descriptors::DescriptorSetWriter(vktDevice)
+				.selectDescriptorSet(yuvIngest.planesSet)
+				.selectBinding(defaultIds::descriptorBindings::frame_planes_storage_buffer)
+				.registerWriteBuffer(frameSlot.vktYuvPlanes, yuvPlanesSize(FRAME_W, FRAME_H), 0)
+				.writeRegistered();
+
+			// draw the converted frame into the post process source
+
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = yuvIngest.renderPass;
+			renderPassInfo.framebuffer = yuvIngest.framebuffer;
+			renderPassInfo.renderArea.offset = { 0, 0 };
+			renderPassInfo.renderArea.extent = extent;
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport{};
+			viewport.width = static_cast<float>(extent.width);
+			viewport.height = static_cast<float>(extent.height);
+			viewport.maxDepth = 1.0f;
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+			VkRect2D scissor{};
+			scissor.extent = extent;
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			vkt::Rendering::Material* material = materials.get(defaultIds::materials::yuv_to_rgb);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipeline);
+			material->cmdBindDescriptors(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+			YuvPushConstants constants{};
+			constants.format = fmt == 'YV12' ? 0 : 1;
+			constants.matrix = yuvUsesBT709() ? 1 : 0;
+			constants.width = FRAME_W;
+			constants.height = FRAME_H;
+			material->cmdPushConstants(commandBuffer, VK_SHADER_STAGE_FRAGMENT_BIT, &constants, 0);
+
+			vkt::Rendering::Mesh* quad = *meshes.get(defaultIds::meshes::quad);
+			VkDeviceSize offset = 0;
+			VkBuffer vertexBuffer = quad->getVertexBuffer()->getBuffer();
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+			vkCmdDraw(commandBuffer, static_cast<uint32_t>(quad->getVertices().size()), 1, 0, 0);
+
+			// post process source is now transfer src optimal
+
+			vkCmdEndRenderPass(commandBuffer);
+
+			recordInputLayers(commandBuffer, frameSlot);
+
+			// retransition post process source to shader read optimal
+
+			vkt::commands::insertImageMemoryBarrier(commandBuffer, vktPostProcessSource->getImage(),
+													VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+													VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+													VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+													VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+													VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+		}
+		else
+		{
+			// only the tiles that changed since the previous frame are written to the post process source, which
+			// keeps the rest of the previous frame, then the whole frame is copied to the color attachment on the gpu
+
+			// the copies run on the transfer queue, which only owns the previous contents if drawFrame released them
+			bool onTransferQueue = frameIOPaths.transferQueue && !frameIOPaths.hostImageCopy;
+
+			if (onTransferQueue && !postProcessSourceOnTransfer)
+				dirtyTiles.invalidate();
+
+			bool partial = dirtyTiles.update(srcBuffer, FRAME_W, FRAME_H, static_cast<uint32_t>(frameRowspan));
+
+			std::vector<VkRect2D> dirtyRects;
+			for (const DirtyTileTracker::Rect& rect : dirtyTiles.getDirtyRects())
+				dirtyRects.push_back({ { (int32_t)rect.x, (int32_t)rect.y }, { rect.width, rect.height } });
+
+			VkImageLayout previousLayout =
+				partial ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+
+			if (frameIOPaths.hostImageCopy)
+			{
+				// write the post process source from the host (the previous frames are done with it), no staging
+
+				vkt::commands::hostCopyMemoryToImage(vktDevice, srcBuffer, frameRowspan / sizeof(LICE_pixel),
+													 sizeof(LICE_pixel), vktPostProcessSource->getImage(),
+													 previousLayout, dirtyRects);
+
+				// host writes are visible to the submission
+
+				vkt::commands::insertImageMemoryBarrier(
+					commandBuffer, vktPostProcessSource->getImage(), 0, VK_ACCESS_TRANSFER_READ_BIT,
+					VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+			}
+			else
+			{
+				uint32_t graphicsFamily = vktDevice->getGraphicsQueue()->getFamilyIndex();
+				uint32_t transferFamily = vktDevice->getTransferQueue()->getFamilyIndex();
+
+				// the copies are recorded in the transfer command buffer when on the transfer queue
+				VkCommandBuffer copyCommandBuffer = commandBuffer;
+
+				if (onTransferQueue)
+					copyCommandBuffer = frameSlot.frameContext->createCommandBuffer(vktDevice->getTransferQueue());
+
+				if (onTransferQueue && partial)
+				{
+					// acquire the previous frame, released by drawFrame (same barrier as the release)
+
+					vkt::commands::insertImageMemoryBarrier(
+						copyCommandBuffer, vktPostProcessSource->getImage(), 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+						VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+						VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, graphicsFamily,
+						transferFamily);
+				}
+				else
+				{
+					// post process source goes dst optimal
+
+					vkt::commands::insertImageMemoryBarrier(
+						copyCommandBuffer, vktPostProcessSource->getImage(), 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+						previousLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+						VK_PIPELINE_STAGE_TRANSFER_BIT, VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+				}
+
+				// buffer image copies need a texel aligned offset and row length, nothing to import for a static frame
+
+				bool imported = frameIOPaths.importHostMemory && !dirtyRects.empty() &&
+								frameRowspan % sizeof(LICE_pixel) == 0 &&
+								frameSlot.vktImportedFrame->import(srcBuffer, frameSize,
+																   VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+																	   VK_BUFFER_USAGE_TRANSFER_DST_BIT) &&
+								frameSlot.vktImportedFrame->getOffset() % sizeof(LICE_pixel) == 0;
+
+				if (imported)
+				{
+					// the gpu reads the changed tiles straight from the video frame bits
+
+					vkt::commands::copyBufferRectsToImage(copyCommandBuffer, frameSlot.vktImportedFrame->getBuffer(),
+														  frameSlot.vktImportedFrame->getOffset(),
+														  frameRowspan / sizeof(LICE_pixel), sizeof(LICE_pixel),
+														  vktPostProcessSource->getImage(), dirtyRects);
+				}
+				else
+				{
+					frameSlot.vktImportedFrame->release();
+
+					// transition frametransfer to general (as host write reciever)
+
+					vkt::commands::insertImageMemoryBarrier(
+						copyCommandBuffer, vktFrameTransfer->getImage(), 0, VK_ACCESS_MEMORY_WRITE_BIT,
+						VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+						VK_PIPELINE_STAGE_TRANSFER_BIT, VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+
+					// copy the changed tiles to the same place in the mapped frametransfer (rows are rowPitch apart)
+
+					VkImageSubresource subResource{};
+					subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					VkSubresourceLayout subResourceLayout;
+
+					vkGetImageSubresourceLayout(vktDevice->vk(), vktFrameTransfer->getImage(), &subResource,
+												&subResourceLayout);
+
+					uint8_t* mapped =
+						(uint8_t*)(vktFrameTransfer->getAllocationInfo()).pMappedData + subResourceLayout.offset;
+
+					std::vector<VkImageCopy> tileCopyRegions;
+
+					for (const VkRect2D& rect : dirtyRects)
+					{
+						size_t texelOffset = (size_t)rect.offset.x * sizeof(LICE_pixel);
+
+						copyRows(mapped + rect.offset.y * subResourceLayout.rowPitch + texelOffset,
+								 subResourceLayout.rowPitch,
+								 (const uint8_t*)srcBuffer + rect.offset.y * frameRowspan + texelOffset, frameRowspan,
+								 rect.extent.width * sizeof(LICE_pixel), rect.extent.height);
+
+						VkImageCopy tileCopyRegion{};
+						tileCopyRegion.srcSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+						tileCopyRegion.srcOffset = { rect.offset.x, rect.offset.y, 0 };
+						tileCopyRegion.dstSubresource = tileCopyRegion.srcSubresource;
+						tileCopyRegion.dstOffset = tileCopyRegion.srcOffset;
+						tileCopyRegion.extent = { rect.extent.width, rect.extent.height, 1 };
+						tileCopyRegions.push_back(tileCopyRegion);
+					}
+
+					// retransition frametransfer to src copy optimal
+
+					vkt::commands::insertImageMemoryBarrier(copyCommandBuffer, vktFrameTransfer->getImage(),
+															VK_ACCESS_HOST_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+															VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+															VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+															VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+
+					// and copy the tiles to post process source
+
+					if (!tileCopyRegions.empty())
+						vkCmdCopyImage(copyCommandBuffer, vktFrameTransfer->getImage(),
+									   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, vktPostProcessSource->getImage(),
+									   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+									   static_cast<uint32_t>(tileCopyRegions.size()), tileCopyRegions.data());
+				}
+
+				if (onTransferQueue)
+				{
+					// post process source goes src optimal and back to the graphics queue
+
+					vkt::commands::insertImageMemoryBarrier(
+						copyCommandBuffer, vktPostProcessSource->getImage(), VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+						VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+						VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+						VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, transferFamily,
+						graphicsFamily);
+
+					uploadTransferred =
+						frameSlot.frameContext->submit(vktDevice->getTransferQueue(), copyCommandBuffer);
+
+					// acquire
+
+					vkt::commands::insertImageMemoryBarrier(
+						commandBuffer, vktPostProcessSource->getImage(), 0, VK_ACCESS_TRANSFER_READ_BIT,
+						VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+						VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+						VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, transferFamily,
+						graphicsFamily);
+
+					postProcessSourceOnTransfer = false;
+				}
+				else
+				{
+					// post process source goes src optimal
+
+					vkt::commands::insertImageMemoryBarrier(
+						commandBuffer, vktPostProcessSource->getImage(), VK_ACCESS_TRANSFER_WRITE_BIT,
+						VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+						VK_PIPELINE_STAGE_TRANSFER_BIT, VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+				}
+			}
+
+			// the post process pass samples the post process source directly, it's the only copy of the frame
+
+			recordInputLayers(commandBuffer, frameSlot);
+
+			// retransition post process source to shader read optimal
+
+			vkt::commands::insertImageMemoryBarrier(commandBuffer, vktPostProcessSource->getImage(),
+													VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+													VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+													VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+													VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+													VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+		}
+
+		// no cpu wait, drawFrame waits for the uploaded point (and this for the transfer queue copies, if any, and for
+		// the copy of the next instance if the last frame was handed off, the render target is written again)
+
+		frameSlot.uploaded = frameSlot.frameContext->submit(queue, commandBuffer,
+															{ { uploadTransferred, VK_PIPELINE_STAGE_TRANSFER_BIT },
+															  { handOffConsumed, VK_PIPELINE_STAGE_TRANSFER_BIT } });
+
+		// every other path copied the bits on the host already
+		return frameSlot.vktImportedFrame->isImported(srcBuffer, frameSize);
 	}
 
 	/* vulkan */
@@ -499,54 +1711,144 @@ namespace ReaShader
 		VkPhysicalDeviceProperties deviceProperties;
 		vkGetPhysicalDeviceProperties(device, &deviceProperties);
 
-		VkPhysicalDeviceFeatures deviceFeatures;
-		vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+		VkPhysicalDeviceFeatures deviceFeatures;
+		vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+
+		// queue families
+
+		vkt::Physical::QueueFamilyIndices indices = vkt::Physical::findQueueFamilies(device);
+
+		// timeline semaphores (core in 1.2), the renderer syncs on them
+
+		VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{};
+		timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+		if (deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+		{
+			VkPhysicalDeviceFeatures2 features2{};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features2.pNext = &timelineSemaphoreFeatures;
+
+			vkGetPhysicalDeviceFeatures2(device, &features2);
+		}
+
+		// final condition
+
+		return
+#ifdef DEBUG
+		// deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
+#endif
+			indices.graphicsFamily.has_value() && timelineSemaphoreFeatures.timelineSemaphore;
+	}
+
+	// RENDER PASS
+
+	VkRenderPass createRenderPass(vkt::Logical::Device* vktDevice)
+	{
+		vkt::Pipeline::RenderPassBuilder renderPassBuilder(vktDevice);
+
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format = VK_FORMAT_B8G8R8A8_UNORM;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		// the post process chain drew the frame, the objects go over it
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		// the render graph transitions the attachments and synchronizes with the passes around
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentDescription depth_attachment = {};
+		depth_attachment.flags = 0;
+		depth_attachment.format = VK_FORMAT_D32_SFLOAT;
+		depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // transient, not needed after the pass
+		depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depth_attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		enum attachmentTags
+		{
+			colorAttTag,
+			depthAttTag
+		};
+
+		enum subpassTags
+		{
+			mainSubpass
+		};
+
+		renderPassBuilder.addAttachment(std::move(colorAttachment), colorAttTag)
+			.addAttachment(std::move(depth_attachment), depthAttTag);
+
+		renderPassBuilder.initSubpass(VK_PIPELINE_BIND_POINT_GRAPHICS, mainSubpass)
+			.addColorAttachmentRef(colorAttTag, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
+			.setDepthStencilRef(depthAttTag)
+			.endSubpass();
+
+		VkRenderPass renderPass = renderPassBuilder.build();
+
+		return renderPass;
+	}
+
+	// a pass of the post process chain, every pixel is drawn (the attachment is a ping-pong target, an intermediate or
+	// the scene color)
+	VkRenderPass createPostProcessRenderPass(vkt::Logical::Device* vktDevice)
+	{
+		vkt::Pipeline::RenderPassBuilder renderPassBuilder(vktDevice);
+
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format = VK_FORMAT_B8G8R8A8_UNORM;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		// transitions and synchronization by the render graph
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		enum attachmentTags
+		{
+			colorAttTag
+		};
 
-		// queue families
+		enum subpassTags
+		{
+			mainSubpass
+		};
 
-		vkt::Physical::QueueFamilyIndices indices = vkt::Physical::findQueueFamilies(device);
+		renderPassBuilder.addAttachment(std::move(colorAttachment), colorAttTag);
 
-		// final condition
+		renderPassBuilder.initSubpass(VK_PIPELINE_BIND_POINT_GRAPHICS, mainSubpass)
+			.addColorAttachmentRef(colorAttTag, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
+			.endSubpass();
 
-		return
-#ifdef DEBUG
-		// deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
-#endif
-			indices.graphicsFamily.has_value();
+		return renderPassBuilder.build();
 	}
 
-	// RENDER PASS
-
-	VkRenderPass createRenderPass(vkt::Logical::Device* vktDevice)
+	// single attachment pass converting a whole frame (yuv ingest into the post process source, yuv encode of the
+	// rendered frame), the target is then copied
+	VkRenderPass createFrameConversionRenderPass(vkt::Logical::Device* vktDevice, VkFormat format)
 	{
 		vkt::Pipeline::RenderPassBuilder renderPassBuilder(vktDevice);
 
 		VkAttachmentDescription colorAttachment{};
-		colorAttachment.format = VK_FORMAT_B8G8R8A8_UNORM;
+		colorAttachment.format = format;
 		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD; // load existing attachment information
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // every pixel is overwritten
 		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		colorAttachment.finalLayout =
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; // transition from dst to src optimal layout after render finished
-
-		VkAttachmentDescription depth_attachment = {};
-		depth_attachment.flags = 0;
-		depth_attachment.format = VK_FORMAT_D32_SFLOAT;
-		depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; // ready to be copied
 
 		enum attachmentTags
 		{
-			colorAttTag,
-			depthAttTag
+			colorAttTag
 		};
 
 		enum subpassTags
@@ -554,50 +1856,33 @@ namespace ReaShader
 			mainSubpass
 		};
 
-		renderPassBuilder.addAttachment(std::move(colorAttachment), colorAttTag)
-			.addAttachment(std::move(depth_attachment), depthAttTag);
+		renderPassBuilder.addAttachment(std::move(colorAttachment), colorAttTag);
 
 		renderPassBuilder.initSubpass(VK_PIPELINE_BIND_POINT_GRAPHICS, mainSubpass)
 			.addColorAttachmentRef(colorAttTag, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
-			.setDepthStencilRef(depthAttTag)
 			.endSubpass();
 
-		// Use subpass dependencies for layout transitions
+		// previous frame sampled or copied the target
 		VkSubpassDependency colorDependencyInit{};
 		colorDependencyInit.srcSubpass = VK_SUBPASS_EXTERNAL;
 		colorDependencyInit.dstSubpass = mainSubpass;
-		colorDependencyInit.srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		colorDependencyInit.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
 		colorDependencyInit.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		colorDependencyInit.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		colorDependencyInit.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		colorDependencyInit.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-		VkSubpassDependency depthDependency{};
-		depthDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		depthDependency.dstSubpass = mainSubpass;
-		depthDependency.srcStageMask =
-			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-		depthDependency.srcAccessMask = 0;
-		depthDependency.dstStageMask =
-			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-		depthDependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		colorDependencyInit.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		colorDependencyInit.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
 		VkSubpassDependency colorDependencyFinal{};
 		colorDependencyFinal.srcSubpass = mainSubpass;
 		colorDependencyFinal.dstSubpass = VK_SUBPASS_EXTERNAL;
 		colorDependencyFinal.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		colorDependencyFinal.dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		colorDependencyFinal.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		colorDependencyFinal.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		colorDependencyFinal.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		colorDependencyFinal.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		colorDependencyFinal.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		colorDependencyFinal.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
 		renderPassBuilder.addSubpassDependency(std::move(colorDependencyInit))
-			.addSubpassDependency(std::move(depthDependency))
 			.addSubpassDependency(std::move(colorDependencyFinal));
 
-		VkRenderPass renderPass = renderPassBuilder.build();
-
-		return renderPass;
+		return renderPassBuilder.build();
 	}
 
 	// GRAPHICS PIPELINE
@@ -777,13 +2062,14 @@ namespace ReaShader
 		return material;
 	}
 
+	// fullscreen pass of the post process chain, with DefaultPushConstants
+	// (fragShaderModule is destroyed)
 	vkt::Rendering::Material createMaterialPP(vkt::Logical::Device* vktDevice, VkRenderPass& renderPass,
-											  std::vector<VkDescriptorSetLayout> descriptorSetLayouts)
+											  std::vector<VkDescriptorSetLayout> descriptorSetLayouts,
+											  VkShaderModule fragShaderModule)
 	{
 		VkShaderModule vertShaderModule =
 			vkt::Pipeline::createShaderModule(vktDevice, tools::paths::join({ SHADERS_DIR, "pp_vert.spv" }));
-		VkShaderModule fragShaderModule =
-			vkt::Pipeline::createShaderModule(vktDevice, tools::paths::join({ SHADERS_DIR, "pp_frag.spv" }));
 
 		// ---------
 
@@ -857,61 +2143,319 @@ namespace ReaShader
 		multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
 		multisampling.alphaToOneEnable = VK_FALSE;		// Optional
 
-		// color blend attachment
+		// color blend attachment
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.colorWriteMask =
+			VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		// first draw of the pass, nothing is under it (the shader blends over the frame itself)
+		colorBlendAttachment.blendEnable = VK_FALSE;
+
+		// color blend
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.logicOpEnable = VK_FALSE;
+		colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
+		colorBlending.attachmentCount = 1;
+		colorBlending.pAttachments = &colorBlendAttachment;
+		colorBlending.blendConstants[0] = 0.0f; // Optional
+		colorBlending.blendConstants[1] = 0.0f; // Optional
+		colorBlending.blendConstants[2] = 0.0f; // Optional
+		colorBlending.blendConstants[3] = 0.0f; // Optional
+
+		// push constants
+
+		VkPushConstantRange push_constant{};
+		push_constant.offset = 0;
+		push_constant.size = sizeof(DefaultPushConstants);
+		push_constant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		
+		vkt::Rendering::Material material =
+			vkt::Pipeline::MaterialBuilder(vktDevice)
+				.beginPipelineLayout()
+				.setPushConstants(push_constant)
+				.setDescriptors(descriptorSetLayouts)
+				.endPipelineLayout()
+				.beginPipeline()
+				.setShaderStages({ vertShaderStageInfo, fragShaderStageInfo })
+				.setVertexState(vertexInputInfo)
+				.setInputAssembly(inputAssembly)
+				.setViewPortState(viewportState)
+				.setRasterizer(rasterizer)
+				.setMultisampling(multisampling)
+				.setDepthStencil(depthStencilInfo)
+				.setColorBlending(colorBlending)
+				.setDynamicStates({ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR })
+				.endPipeline(renderPass)
+				.build();
+
+		// ---------
+
+		vkDestroyShaderModule(vktDevice->vk(), fragShaderModule, nullptr);
+		vkDestroyShaderModule(vktDevice->vk(), vertShaderModule, nullptr);
+
+		return material;
+	}
+
+	// fragment shader of a fused per pixel pass, signature is the snippets joined by +: each snippet is compiled with its
+	// pixel function renamed, then main samples the previous pass output once and applies them in order
+	std::vector<char> generatePixelKernel(const std::string& signature)
+	{
+		std::string source = "#version 450\n"
+							 "#extension GL_KHR_vulkan_glsl : enable\n"
+							 "layout(location = 0) in vec3 fragColor;\n"
+							 "layout(location = 1) in vec2 texCoord;\n"
+							 "layout(location = 0) out vec4 outColor;\n"
+							 "layout(set = 1, binding = 0) uniform sampler2D postProcessInputs[5];\n"
+							 "layout(push_constant) uniform constants\n"
+							 "{\n"
+							 "	int objectId;\n"
+							 "	float videoParam;\n"
+							 "	int inputCount;\n"
+							 "} pushConstants;\n";
+		std::string body = "void main()\n"
+						   "{\n"
+						   "	vec4 color = texture(postProcessInputs[0], texCoord);\n";
+
+		size_t index = 0;
+		for (size_t begin = 0, end; begin <= signature.size(); begin = end + 1, index++)
+		{
+			end = std::min(signature.find('+', begin), signature.size());
+
+			std::vector<char> snippet =
+				vkt::io::readFile(tools::paths::join({ SHADERS_DIR, signature.substr(begin, end - begin) }));
+			std::string function = "pixel" + std::to_string(index);
+
+			source += "#define pixel " + function + "\n" + std::string(snippet.begin(), snippet.end()) +
+					  "\n#undef pixel\n";
+			body += "	color = " + function + "(color);\n";
+		}
+
+		source += body + "	outColor = color;\n}\n";
+
+		return std::vector<char>(source.begin(), source.end());
+	}
+
+	// compute pass of the post process chain, with DefaultPushConstants, in 16x16 groups (the defaults)
+	vkt::Rendering::Material createMaterialCompute(vkt::Logical::Device* vktDevice,
+												   std::vector<VkDescriptorSetLayout> descriptorSetLayouts,
+												   std::string shaderName, const std::string& defines,
+												   uint32_t pushConstantsSize = sizeof(DefaultPushConstants),
+												   VkExtent2D workgroupSize = { 16, 16 })
+	{
+		VkShaderModule shaderModule = vkt::Pipeline::createShaderModule(
+			vktDevice, EShLangCompute, tools::paths::join({ SHADERS_DIR, shaderName }), defines);
+
+		VkPipelineShaderStageCreateInfo shaderStageInfo{};
+		shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStageInfo.module = shaderModule;
+		shaderStageInfo.pName = "main";
+
+		VkPushConstantRange push_constant{};
+		push_constant.offset = 0;
+		push_constant.size = pushConstantsSize;
+		push_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		vkt::Rendering::Material material = vkt::Pipeline::ComputeMaterialBuilder(vktDevice)
+												 .setPushConstants(push_constant)
+												 .setDescriptors(descriptorSetLayouts)
+												 .setShaderStage(shaderStageInfo)
+												 .setWorkgroupSize(workgroupSize.width, workgroupSize.height)
+												 .build();
+
+		vkDestroyShaderModule(vktDevice->vk(), shaderModule, nullptr);
+
+		return material;
+	}
+
+	// fullscreen pass for createFrameConversionRenderPass, with YuvPushConstants
+	vkt::Rendering::Material createMaterialFrameConversion(vkt::Logical::Device* vktDevice, VkRenderPass& renderPass,
+														   std::vector<VkDescriptorSetLayout> descriptorSetLayouts,
+														   std::string fragShaderName)
+	{
+		VkShaderModule vertShaderModule =
+			vkt::Pipeline::createShaderModule(vktDevice, tools::paths::join({ SHADERS_DIR, "pp_vert.spv" }));
+		VkShaderModule fragShaderModule = vkt::Pipeline::createShaderModule(
+			vktDevice, EShLangFragment, tools::paths::join({ SHADERS_DIR, fragShaderName }));
+
+		// ---------
+
+		// shader stages
+
+		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		vertShaderStageInfo.module = vertShaderModule;
+		vertShaderStageInfo.pName = "main";
+
+		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		fragShaderStageInfo.module = fragShaderModule;
+		fragShaderStageInfo.pName = "main";
+
+		// vertex state (fullscreen quad)
+		vkt::VertexInputDescription vertexInputDesc = vkt::Vertex::get_vertex_description();
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo = vkt::Vertex::get_pipeline_input_state(vertexInputDesc);
+
+		// input assembly state
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+		// viewport
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.scissorCount = 1;
+
+		// rasterization
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.lineWidth = 1.0f;
+		rasterizer.cullMode = VK_CULL_MODE_NONE;
+		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+		// multisample
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		multisampling.minSampleShading = 1.0f;
+
+		// no blending, every pixel is overwritten
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.colorWriteMask =
+			VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		colorBlendAttachment.blendEnable = VK_FALSE;
+
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.attachmentCount = 1;
+		colorBlending.pAttachments = &colorBlendAttachment;
+
+		// push constants
+		VkPushConstantRange push_constant{};
+		push_constant.offset = 0;
+		push_constant.size = sizeof(YuvPushConstants);
+		push_constant.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		vkt::Rendering::Material material =
+			vkt::Pipeline::MaterialBuilder(vktDevice)
+				.beginPipelineLayout()
+				.setPushConstants(push_constant)
+				.setDescriptors(descriptorSetLayouts)
+				.endPipelineLayout()
+				.beginPipeline()
+				.setShaderStages({ vertShaderStageInfo, fragShaderStageInfo })
+				.setVertexState(vertexInputInfo)
+				.setInputAssembly(inputAssembly)
+				.setViewPortState(viewportState)
+				.setRasterizer(rasterizer)
+				.setMultisampling(multisampling)
+				.setColorBlending(colorBlending)
+				.setDynamicStates({ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR })
+				.endPipeline(renderPass)
+				.build();
+
+		// ---------
+
+		vkDestroyShaderModule(vktDevice->vk(), fragShaderModule, nullptr);
+		vkDestroyShaderModule(vktDevice->vk(), vertShaderModule, nullptr);
+
+		return material;
+	}
+
+	// fullscreen pass drawing the unprocessed frame over the rendered one, weighted by the blend constants alpha
+	vkt::Rendering::Material createMaterialDryMix(vkt::Logical::Device* vktDevice, VkRenderPass& renderPass,
+												  std::vector<VkDescriptorSetLayout> descriptorSetLayouts)
+	{
+		VkShaderModule vertShaderModule =
+			vkt::Pipeline::createShaderModule(vktDevice, tools::paths::join({ SHADERS_DIR, "pp_vert.spv" }));
+		VkShaderModule fragShaderModule = vkt::Pipeline::createShaderModule(
+			vktDevice, EShLangFragment, tools::paths::join({ SHADERS_DIR, "mix_frag.glsl" }));
+
+		// ---------
+
+		// shader stages
+
+		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		vertShaderStageInfo.module = vertShaderModule;
+		vertShaderStageInfo.pName = "main";
+
+		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		fragShaderStageInfo.module = fragShaderModule;
+		fragShaderStageInfo.pName = "main";
+
+		// vertex state (fullscreen quad)
+		vkt::VertexInputDescription vertexInputDesc = vkt::Vertex::get_vertex_description();
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo = vkt::Vertex::get_pipeline_input_state(vertexInputDesc);
+
+		// input assembly state
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+		// viewport
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.scissorCount = 1;
+
+		// depth stencil, drawn over everything
+
+		VkPipelineDepthStencilStateCreateInfo depthStencilInfo = {};
+		depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencilInfo.depthTestEnable = VK_FALSE;
+		depthStencilInfo.depthWriteEnable = VK_FALSE;
+		depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		depthStencilInfo.maxDepthBounds = 1.0f;
+
+		// rasterization
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.lineWidth = 1.0f;
+		rasterizer.cullMode = VK_CULL_MODE_NONE;
+		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+		// multisample
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		multisampling.minSampleShading = 1.0f;
+
+		/* wet/dry mix, the blend constants alpha is the dry amount:
+
+			finalColor = dry * constant.a + wet * (1 - constant.a)
+
+		*/
 		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
 		colorBlendAttachment.colorWriteMask =
 			VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 		colorBlendAttachment.blendEnable = VK_TRUE;
-		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_CONSTANT_ALPHA;
+		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA;
 		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_CONSTANT_ALPHA;
+		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA;
 		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
-		/*	Color blend Pseudocode:
-
-			if (blendEnable) {
-				finalColor.rgb = (srcColorBlendFactor * newColor.rgb) <colorBlendOp> (dstColorBlendFactor *
-		   oldColor.rgb); finalColor.a = (srcAlphaBlendFactor * newColor.a) <alphaBlendOp> (dstAlphaBlendFactor *
-		   oldColor.a); } else { finalColor = newColor;
-			}
-
-			finalColor = finalColor & colorWriteMask;
-
-		*/
-
-		/* Simple alpha blending :
-
-			finalColor.rgb = newAlpha * newColor + (1 - newAlpha) * oldColor;
-			finalColor.a = newAlpha.a;
-
-		*/
-
-		// color blend
 		VkPipelineColorBlendStateCreateInfo colorBlending{};
 		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		colorBlending.logicOpEnable = VK_FALSE;
-		colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
 		colorBlending.attachmentCount = 1;
 		colorBlending.pAttachments = &colorBlendAttachment;
-		colorBlending.blendConstants[0] = 0.0f; // Optional
-		colorBlending.blendConstants[1] = 0.0f; // Optional
-		colorBlending.blendConstants[2] = 0.0f; // Optional
-		colorBlending.blendConstants[3] = 0.0f; // Optional
-
-		// push constants
-
-		VkPushConstantRange push_constant{};
-		push_constant.offset = 0;
-		push_constant.size = sizeof(DefaultPushConstants);
-		push_constant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
-		
 		vkt::Rendering::Material material =
 			vkt::Pipeline::MaterialBuilder(vktDevice)
 				.beginPipelineLayout()
-				.setPushConstants(push_constant)
 				.setDescriptors(descriptorSetLayouts)
 				.endPipelineLayout()
 				.beginPipeline()
@@ -923,7 +2467,8 @@ namespace ReaShader
 				.setMultisampling(multisampling)
 				.setDepthStencil(depthStencilInfo)
 				.setColorBlending(colorBlending)
-				.setDynamicStates({ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR })
+				.setDynamicStates(
+					{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_BLEND_CONSTANTS })
 				.endPipeline(renderPass)
 				.build();
 
@@ -981,9 +2526,10 @@ namespace ReaShader
 
 	void ReaShaderRenderer::_initVulkan()
 	{
-		// instance
+		// instance (shared by all the plugin instances)
 		{
-			myVkInstance = vkt::createVkInstance(vktMainDeletionQueue, "ReaShader Effect", "No Engine");
+			myVkInstance = DeviceManager::acquireInstance();
+			vktMainDeletionQueue.push_function([=]() { DeviceManager::releaseInstance(); });
 		}
 
 		// device
@@ -1022,9 +2568,16 @@ namespace ReaShader
 	{
 		halted = true;
 
-		vktDevice->waitIdle();
+		// a handed off frame would be read back through the old device
+		FrameHandoff::retire(this);
+		handOffConsumer = nullptr;
+		handOffConsumed = {};
+
+		// the device is shared, wait for the queues instead of the whole device
+		vktDevice->getGraphicsQueue()->waitSubmitted();
+		vktDevice->getTransferQueue()->waitSubmitted();
 
-		vktFrameResizedDeletionQueue.flush();
+		clearRenderTargets();
 		vktPhysicalDeviceChangedDeletionQueue.flush();
 
 		setUpDevice(renderingDeviceIndex);
@@ -1037,123 +2590,616 @@ namespace ReaShader
 		// device
 
 		{
-			vktPhysicalDevice = new vkt::Physical::Device(vktPhysicalDeviceChangedDeletionQueue, myVkInstance,
-														  vkSuitablePhysicalDevices[renderingDeviceIndex]);
+			// shared with the other plugin instances on the same physical device, released last (after everything
+			// created through it)
+
+			sharedDevice = DeviceManager::acquireDevice(vkSuitablePhysicalDevices[renderingDeviceIndex]);
+			DeviceManager::SharedDevice* releasedDevice = sharedDevice;
+			vktPhysicalDeviceChangedDeletionQueue.push_function(
+				[=]() { DeviceManager::releaseDevice(releasedDevice); });
+
+			vktPhysicalDevice = sharedDevice->physicalDevice;
+			vktDevice = new vkt::Logical::Device(vktPhysicalDeviceChangedDeletionQueue, sharedDevice->device);
+
+			frameIOPaths.hostImageCopy = vktDevice->extensionEnabled(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME) &&
+										 vktDevice->ext.copyMemoryToImage && vktDevice->ext.transitionImageLayout;
+			frameIOPaths.importHostMemory = vkt::Buffers::ImportedHostBuffer::isSupported(vktDevice);
+			// the logical device falls back to the graphics family if there's no dedicated transfer family
+			frameIOPaths.transferQueue = vktDevice->getTransferQueue()->getFamilyIndex() !=
+										 vktDevice->getGraphicsQueue()->getFamilyIndex();
+		}
+
+		// adaptive resolution: linear blits of the render target and timestamps of the draw
+
+		{
+			VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+												VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+			adaptiveResolution.supported =
+				(vktPhysicalDevice->getFormatProperties(VK_FORMAT_B8G8R8A8_UNORM).optimalTilingFeatures &
+				 blitFeatures) == blitFeatures &&
+				vktPhysicalDevice->deviceProperties.limits.timestampComputeAndGraphics;
+			adaptiveResolution.timestampPeriod = vktPhysicalDevice->deviceProperties.limits.timestampPeriod;
+			adaptiveResolution.level = 0;
+			adaptiveResolution.drawMs = 0;
+			adaptiveResolution.samples = 0;
+			adaptiveResolution.queryPool = VK_NULL_HANDLE;
+
+			if (adaptiveResolution.supported)
+			{
+				VkQueryPoolCreateInfo queryPoolInfo{};
+				queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+				queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+				queryPoolInfo.queryCount = 2 * FRAMES_IN_FLIGHT;
+
+				VK_CHECK_RESULT(
+					vkCreateQueryPool(vktDevice->vk(), &queryPoolInfo, nullptr, &adaptiveResolution.queryPool));
+
+				VkDevice device = vktDevice->vk();
+				VkQueryPool queryPool = adaptiveResolution.queryPool;
+				vktPhysicalDeviceChangedDeletionQueue.push_function(
+					[=]() { vkDestroyQueryPool(device, queryPool, nullptr); });
+			}
+		}
+
+		// compute post process passes, dispatched on the graphics queue, told which subgroup operations they can use
+
+		{
+			uint32_t familyCount = 0;
+			vkGetPhysicalDeviceQueueFamilyProperties(vktPhysicalDevice->vk(), &familyCount, nullptr);
+			std::vector<VkQueueFamilyProperties> families(familyCount);
+			vkGetPhysicalDeviceQueueFamilyProperties(vktPhysicalDevice->vk(), &familyCount, families.data());
+
+			postProcessChain.computeSupported =
+				families[vktDevice->getGraphicsQueue()->getFamilyIndex()].queueFlags & VK_QUEUE_COMPUTE_BIT;
+
+			VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+			subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
 
-			vktDevice = new vkt::Logical::Device(vktPhysicalDeviceChangedDeletionQueue, vktPhysicalDevice);
+			VkPhysicalDeviceProperties2 properties{};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			properties.pNext = &subgroupProperties;
+			vkGetPhysicalDeviceProperties2(vktPhysicalDevice->vk(), &properties);
+
+			std::string& defines = postProcessChain.computeDefines;
+			defines = "#define SUBGROUP_SIZE " + std::to_string(subgroupProperties.subgroupSize) + "\n";
+
+			if (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT)
+			{
+				if (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT)
+					defines += "#define SUBGROUP_ARITHMETIC\n";
+				if (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_SHUFFLE_BIT)
+					defines += "#define SUBGROUP_SHUFFLE\n";
+			}
+
+			if (!postProcessChain.computeSupported)
+				LOG(WARNING, toFile | toConsole, "ReaShaderRenderer", "Compute post processing unavailable",
+					"The graphics queue doesn't support compute, the compute passes are skipped");
 		}
 
-		// command buffers
+		// the render objects, culled on the graphics queue and drawn indirectly with what the device supports
+
+		scene.supported = postProcessChain.computeSupported;
+		scene.multiDraw = vktDevice->enabledFeatures.multiDrawIndirect;
+		scene.indirectCount = scene.multiDraw && vktDevice->ext.cmdDrawIndexedIndirectCount;
+
+		if (!scene.supported)
+			LOG(WARNING, toFile | toConsole, "ReaShaderRenderer", "Scene unavailable",
+				"The graphics queue doesn't support compute, the objects are not drawn");
+
+		// passes of the frame, its transient memory follows the device
+		renderGraph = new vkt::RenderGraph(vktPhysicalDeviceChangedDeletionQueue, vktDevice);
+
+		// frame slots
+		for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++)
 		{
-			vktDevice->getGraphicsCommandPool()->createCommandBuffers(
-				{ defaultIds::commandBuffers::draw, defaultIds::commandBuffers::transfer },
-				{ &vkDrawCommandBuffer, &vkTransferCommandBuffer });
+			FrameSlot& frameSlot = frameSlots[i];
+
+			// command buffers, per thread pools reset when the slot is reused
+			frameSlot.frameContext = new vkt::FrameContext(vktPhysicalDeviceChangedDeletionQueue, vktDevice->vk());
+
+			// empty points, so the first use of the slot doesn't wait
+			frameSlot.uploaded = frameSlot.rendered = frameSlot.readBack = {};
+			frameSlot.scaleLevel = 0;
+			frameSlot.timed = false;
+			frameSlot.inputCount = 1;
+
+			frameSlot.vktImportedFrame = new vkt::Buffers::ImportedHostBuffer(vktDevice);
+			frameSlot.vktImportedOutputFrame = new vkt::Buffers::ImportedHostBuffer(vktDevice);
+
+			// grown with the scene, allocated by the first draw
+			frameSlot.sceneDraws = {};
+			vktPhysicalDeviceChangedDeletionQueue.push_function([&frameSlot]() {
+				FrameSlot::SceneDraws& draws = frameSlot.sceneDraws;
+				for (vkt::Buffers::AllocatedBuffer* buffer :
+					 { draws.objects, draws.commands, draws.counts, draws.instances })
+					if (buffer)
+						buffer->destroy();
+				draws = {};
+			});
 		}
 
-		vkInFlightFence = vkt::sync::createFence(vktDevice, false);
-		vkRenderFinishedSemaphore = vkt::sync::createSemaphore(vktDevice);
-		vkImageAvailableSemaphore = vkt::sync::createSemaphore(vktDevice);
+		currentFrameSlot = 0;
 
 		// check init properties
 
-		// Check blit support for source and destination
-		if (!vktPhysicalDevice->supportsBlit())
+		if (!frameIOPaths.hostImageCopy && !frameIOPaths.importHostMemory)
 		{
-			std::cerr << "Device does not support blitting to linear tiled images, using copy instead of blit!"
+			std::cerr << "Device does not support host image copy nor host memory import, using staging copies!"
 					  << std::endl;
 		}
 
 		_setupRendering();
 	}
 
-	void ReaShaderRenderer::createRenderTargets()
+	ReaShaderRenderer::RenderTargets* ReaShaderRenderer::createRenderTargets()
 	{
-		auto frameResizedDeletionQueue = &vktFrameResizedDeletionQueue;
+		RenderTargets* renderTargets = new RenderTargets{ FRAME_W, FRAME_H, VK_FORMAT_B8G8R8A8_UNORM };
+		auto frameResizedDeletionQueue = &renderTargets->deletionQueue;
 
 		// render target
 
-		vktColorAttachment = new vkt::Images::AllocatedImage(vktDevice, frameResizedDeletionQueue);
-		vktColorAttachment->createImage(
-			{ FRAME_W, FRAME_H }, VK_IMAGE_TYPE_2D, VK_FORMAT_B8G8R8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+		renderTargets->colorAttachment = new vkt::Images::AllocatedImage(vktDevice, frameResizedDeletionQueue);
+		renderTargets->colorAttachment->createImage(
+			{ FRAME_W, FRAME_H }, VK_IMAGE_TYPE_2D, renderTargets->format, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+				VK_IMAGE_USAGE_SAMPLED_BIT, // sampled by the yuv encode
 			VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		vktColorAttachment->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_B8G8R8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+		renderTargets->colorAttachment->createImageView(VK_IMAGE_VIEW_TYPE_2D, renderTargets->format,
+														VK_IMAGE_ASPECT_COLOR_BIT);
 
-		// depth buffer
+		// frame transfer (one per slot)
 
-		vktDepthAttachment = new vkt::Images::AllocatedImage(vktDevice, frameResizedDeletionQueue);
-		vktDepthAttachment->createImage(
-			{ FRAME_W, FRAME_H }, VK_IMAGE_TYPE_2D, VK_FORMAT_D32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		vktDepthAttachment->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT);
+		for (vkt::Images::AllocatedImage*& frameTransfer : renderTargets->frameTransfers)
+		{
+			frameTransfer = new vkt::Images::AllocatedImage(vktDevice, frameResizedDeletionQueue);
+			frameTransfer->createImage(
+				{ FRAME_W, FRAME_H }, VK_IMAGE_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_LINEAR,
+				VK_IMAGE_USAGE_TRANSFER_SRC_BIT, // upload only, readbacks go through the readback buffer
+				VMA_MEMORY_USAGE_CPU_TO_GPU, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+		}
 
-		// frame transfer
+		// post process source
 
-		vktFrameTransfer = new vkt::Images::AllocatedImage(vktDevice, frameResizedDeletionQueue);
-		vktFrameTransfer->createImage(
-			{ FRAME_W, FRAME_H }, VK_IMAGE_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_LINEAR,
-			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, // both src and dst for copy cmds
-			VMA_MEMORY_USAGE_GPU_TO_CPU, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+		renderTargets->postProcessSource = new vkt::Images::AllocatedImage(vktDevice, frameResizedDeletionQueue);
+		// keeps the ingested frame (only changed tiles are uploaded), copied to the color attachment
+		VkImageUsageFlags postProcessSourceUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+												   VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+												   VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (frameIOPaths.hostImageCopy) // written from the host
+			postProcessSourceUsage |= VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
 
-		// post process source
+		renderTargets->postProcessSource->createImage({ FRAME_W, FRAME_H }, VK_IMAGE_TYPE_2D, renderTargets->format,
+													  VK_IMAGE_TILING_OPTIMAL, postProcessSourceUsage,
+													  VMA_MEMORY_USAGE_GPU_ONLY, NULL);
+		renderTargets->postProcessSource->createImageView(VK_IMAGE_VIEW_TYPE_2D, renderTargets->format,
+														  VK_IMAGE_ASPECT_COLOR_BIT);
+
+		// yuv planes (one per slot) and yuv to rgb target
+
+		for (vkt::Buffers::AllocatedBuffer*& yuvPlanes : renderTargets->yuvPlanes)
+		{
+			yuvPlanes = new vkt::Buffers::AllocatedBuffer(vktDevice, false);
+			yuvPlanes->allocate(
+				yuvPlanesSize(FRAME_W, FRAME_H), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+				VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+			vkt::Buffers::AllocatedBuffer* buffer = yuvPlanes;
+			frameResizedDeletionQueue->push_function([=]() { buffer->destroy(); });
+		}
+
+		renderTargets->yuvIngestFramebuffer =
+			vkt::Pipeline::createFramebuffer(vktDevice, frameResizedDeletionQueue, yuvIngest.renderPass,
+											 { FRAME_W, FRAME_H }, { renderTargets->postProcessSource });
+
+		// yuv encode target (big enough for every format)
+
+		VkExtent2D yv12Extent = yuvEncodedExtent('YV12', FRAME_W, FRAME_H);
+		VkExtent2D yuy2Extent = yuvEncodedExtent('YUY2', FRAME_W, FRAME_H);
+		VkExtent2D encodeExtent{ std::max(yv12Extent.width, yuy2Extent.width),
+								 std::max(yv12Extent.height, yuy2Extent.height) };
+
+		renderTargets->yuvEncodeTarget = new vkt::Images::AllocatedImage(vktDevice, frameResizedDeletionQueue);
+		renderTargets->yuvEncodeTarget->createImage(
+			encodeExtent, VK_IMAGE_TYPE_2D, VK_FORMAT_R8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_GPU_ONLY,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		renderTargets->yuvEncodeTarget->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R8_UNORM,
+														VK_IMAGE_ASPECT_COLOR_BIT);
+
+		renderTargets->yuvEncodeFramebuffer =
+			vkt::Pipeline::createFramebuffer(vktDevice, frameResizedDeletionQueue, yuvEncode.renderPass,
+											 encodeExtent, { renderTargets->yuvEncodeTarget });
+
+		// readback (one per slot), rgba frames or encoded yuv planes, host cached and persistently mapped
+
+		size_t frameBytes = sizeof(LICE_pixel) * FRAME_W * FRAME_H;
+		size_t encodeBytes = (size_t)encodeExtent.width * encodeExtent.height;
+		size_t readbackSize = std::max(frameBytes, encodeBytes);
+
+		for (vkt::Buffers::AllocatedBuffer*& readback : renderTargets->readbacks)
+		{
+			readback = new vkt::Buffers::AllocatedBuffer(vktDevice, false);
+			readback->allocate(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU,
+							   VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+			vkt::Buffers::AllocatedBuffer* buffer = readback;
+			frameResizedDeletionQueue->push_function([=]() { buffer->destroy(); });
+		}
+
+		// color and post process source, plus per slot staging, yuv planes and readback (the depth is a transient of
+		// the render graph)
+		renderTargets->bytes = 2 * frameBytes + encodeBytes +
+							   FRAMES_IN_FLIGHT * (frameBytes + yuvPlanesSize(FRAME_W, FRAME_H) + readbackSize);
+
+		// input layers
+
+		renderTargets->inputLayers = new vkt::Images::AllocatedImage(vktDevice, frameResizedDeletionQueue);
+		renderTargets->inputLayers->createImage({ FRAME_W, FRAME_H }, VK_IMAGE_TYPE_2D, renderTargets->format,
+												VK_IMAGE_TILING_OPTIMAL,
+												VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+												VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, NULL,
+												MAX_FRAME_INPUTS);
+		renderTargets->inputLayers->createImageView(VK_IMAGE_VIEW_TYPE_2D_ARRAY, renderTargets->format,
+													VK_IMAGE_ASPECT_COLOR_BIT);
+
+		renderTargets->bytes += MAX_FRAME_INPUTS * frameBytes;
+
+		// the first set is created before the layout, _setupRendering writes it
+
+		if (virtualSceneData.textureSet.layout)
+			writeTextureSet(renderTargets);
+
+		return renderTargets;
+	}
+
+	void ReaShaderRenderer::writeTextureSet(RenderTargets* renderTargets)
+	{
+		// its own pool, freed with the set
+
+		VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+									   static_cast<uint32_t>(virtualSceneData.textureSet.bindings.size()) };
+
+		VkDescriptorPoolCreateInfo poolInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+
+		VK_CHECK_RESULT(vkCreateDescriptorPool(vktDevice->vk(), &poolInfo, nullptr, &renderTargets->descriptorPool));
+
+		VkDevice device = vktDevice->vk();
+		VkDescriptorPool descriptorPool = renderTargets->descriptorPool;
+		renderTargets->deletionQueue.push_function(
+			[=]() { vkDestroyDescriptorPool(device, descriptorPool, nullptr); });
+
+		renderTargets->textureSet = virtualSceneData.textureSet;
+
+		VkDescriptorSetAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &renderTargets->textureSet.layout;
+
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(vktDevice->vk(), &allocInfo, &renderTargets->textureSet.set));
+
+		vkt::Descriptors::DescriptorSetWriter(vktDevice)
+			.selectDescriptorSet(renderTargets->textureSet)
+			.selectBinding(defaultIds::descriptorBindings::texture_combined_image_sampler)
+			.registerWriteImage(*textures.get(defaultIds::textures::logo), vkSampler,
+								VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+			.selectBinding(defaultIds::descriptorBindings::sampled_frame)
+			.registerWriteImage(renderTargets->postProcessSource, vkSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+			.selectBinding(defaultIds::descriptorBindings::input_layers)
+			.registerWriteImage(renderTargets->inputLayers, vkSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+			.writeRegistered();
+	}
+
+	void ReaShaderRenderer::recordInputLayers(VkCommandBuffer commandBuffer, FrameSlot& frameSlot)
+	{
+		RenderTargets* renderTargets = renderTargetPool.front();
+		VkImage inputLayers = renderTargets->inputLayers->getImage();
+
+		uint32_t extraInputs = pendingInputCount;
+		pendingInputCount = 0;
+		frameSlot.inputCount = 1 + extraInputs;
+
+		// only the processed frame, shaders sample it directly (the layers just need a valid layout once)
+		if (!extraInputs && renderTargets->inputLayersReady)
+			return;
+
+		VkImageSubresourceRange allLayers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, MAX_FRAME_INPUTS };
+
+		// every used layer is rewritten, waits for the draws still sampling them
+
+		vkt::commands::insertImageMemoryBarrier(commandBuffer, inputLayers, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+												VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+												VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+												allLayers);
+
+		if (extraInputs)
+		{
+			size_t frameBytes = sizeof(LICE_pixel) * FRAME_W * FRAME_H;
+
+			vkt::Buffers::AllocatedBuffer*& staging = renderTargets->inputStaging[&frameSlot - frameSlots.data()];
+			if (!staging)
+			{
+				staging = new vkt::Buffers::AllocatedBuffer(vktDevice, false);
+				staging->allocate(
+					(MAX_FRAME_INPUTS - 1) * frameBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+					VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+				vkt::Buffers::AllocatedBuffer* buffer = staging;
+				renderTargets->deletionQueue.push_function([=]() { buffer->destroy(); });
+
+				renderTargets->bytes += (MAX_FRAME_INPUTS - 1) * frameBytes;
+			}
+
+			// packed at frame size, one after the other, so a single copy uploads them all
+
+			uint8_t* packed = (uint8_t*)staging->getMappedData();
+			std::array<VkBufferImageCopy, MAX_FRAME_INPUTS - 1> regions{};
+
+			for (uint32_t i = 0; i < extraInputs; i++)
+			{
+				const FrameInput& input = pendingInputs[i];
+				uint32_t* layer = (uint32_t*)(packed + i * frameBytes);
+
+				if (input.w == (int)FRAME_W && input.h == (int)FRAME_H)
+				{
+					copyRows(layer, sizeof(LICE_pixel) * FRAME_W, input.bits, input.rowspan, sizeof(LICE_pixel) * FRAME_W,
+							 FRAME_H);
+				}
+				else
+				{
+					// another size, stretched to the frame (nearest)
+					for (uint32_t y = 0; y < FRAME_H; y++)
+					{
+						const uint32_t* row = (const uint32_t*)((const uint8_t*)input.bits +
+																(size_t)(y * input.h / FRAME_H) * input.rowspan);
+						for (uint32_t x = 0; x < FRAME_W; x++)
+							layer[(size_t)y * FRAME_W + x] = row[x * input.w / FRAME_W];
+					}
+				}
+
+				regions[i].bufferOffset = i * frameBytes;
+				regions[i].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, i + 1, 1 };
+				regions[i].imageExtent = { FRAME_W, FRAME_H, 1 };
+			}
+
+			VK_CHECK_RESULT(vmaFlushAllocation(vktDevice->vmaAllocator, staging->getAllocation(), 0,
+											   extraInputs * frameBytes))
 
-		vktPostProcessSource = new vkt::Images::AllocatedImage(vktDevice, frameResizedDeletionQueue);
-		vktPostProcessSource->createImage(
-			{ FRAME_W, FRAME_H }, VK_IMAGE_TYPE_2D, VK_FORMAT_B8G8R8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY, NULL);
-		vktPostProcessSource->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_B8G8R8A8_UNORM,
-											  VK_IMAGE_ASPECT_COLOR_BIT);
+			vkCmdCopyBufferToImage(commandBuffer, staging->getBuffer(), inputLayers,
+								   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, extraInputs, regions.data());
 
-		// framebuffer
+			// the processed frame is layer 0
 
-		vkFramebuffer =
-			vkt::Pipeline::createFramebuffer(vktDevice, frameResizedDeletionQueue, vkRenderPass, { FRAME_W, FRAME_H },
-											 { vktColorAttachment, vktDepthAttachment });
+			VkImageCopy copyRegion{};
+			copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copyRegion.extent = { FRAME_W, FRAME_H, 1 };
+
+			vkCmdCopyImage(commandBuffer, vktPostProcessSource->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+						   inputLayers, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+		}
+
+		vkt::commands::insertImageMemoryBarrier(commandBuffer, inputLayers, VK_ACCESS_TRANSFER_WRITE_BIT,
+												VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+												VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+												VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+												allLayers);
+
+		renderTargets->inputLayersReady = true;
+	}
+
+	VkExtent2D ReaShaderRenderer::getScaledExtent(uint32_t level)
+	{
+		RenderTargets* renderTargets = renderTargetPool.front();
+
+		return { std::max(1u, (uint32_t)(renderTargets->w * renderScaleLevels[level])),
+				 std::max(1u, (uint32_t)(renderTargets->h * renderScaleLevels[level])) };
+	}
+
+	void ReaShaderRenderer::updateRenderScale(uint32_t slot)
+	{
+		FrameSlot& frameSlot = frameSlots[slot];
+
+		if (!frameSlot.timed)
+			return;
+		frameSlot.timed = false;
+
+		// the draw is done (the readback waited for it)
+
+		uint64_t timestamps[2];
+		if (vkGetQueryPoolResults(vktDevice->vk(), adaptiveResolution.queryPool, slot * 2, 2, sizeof(timestamps),
+								  timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+			return;
+
+		// frames drawn before the last level change don't count
+		if (frameSlot.scaleLevel != adaptiveResolution.level || adaptiveResolution.frameBudgetMs <= 0)
+			return;
+
+		double drawMs = (timestamps[1] - timestamps[0]) * adaptiveResolution.timestampPeriod / 1e6;
+
+		adaptiveResolution.drawMs =
+			adaptiveResolution.samples ? adaptiveResolution.drawMs * 0.8 + drawMs * 0.2 : drawMs;
+
+		// a few frames before deciding, so a single slow frame doesn't change the level
+		if (++adaptiveResolution.samples < 8)
+			return;
+
+		// the draw has to leave room for upload and readback
+		double budgetMs = adaptiveResolution.frameBudgetMs * 0.6;
+		uint32_t level = adaptiveResolution.level;
+
+		if (adaptiveResolution.drawMs > budgetMs && level + 1 < renderScaleLevelCount)
+		{
+			level++;
+		}
+		else if (level > 0)
+		{
+			// the draw time grows about with the area, step up only if the bigger scale fits with some margin
+			double areaRatio = renderScaleLevels[level - 1] * renderScaleLevels[level - 1] /
+							   (renderScaleLevels[level] * renderScaleLevels[level]);
+			if (adaptiveResolution.drawMs * areaRatio < budgetMs * 0.8)
+				level--;
+		}
+
+		if (level != adaptiveResolution.level)
+		{
+			adaptiveResolution.level = level;
+			adaptiveResolution.samples = 0;
+		}
+	}
+
+	void ReaShaderRenderer::useRenderTargets()
+	{
+		auto found = std::find_if(renderTargetPool.begin(), renderTargetPool.end(), [&](RenderTargets* pooled) {
+			return pooled->w == FRAME_W && pooled->h == FRAME_H && pooled->format == VK_FORMAT_B8G8R8A8_UNORM;
+		});
+
+		if (found == renderTargetPool.begin() && found != renderTargetPool.end())
+			return;
+
+		// the set in use until now may still be read by the last submissions
+		if (!renderTargetPool.empty())
+		{
+			renderTargetPool.front()->lastGraphicsUse = { vktDevice->getGraphicsQueue()->getTimeline(),
+														  vktDevice->getGraphicsQueue()->getTimeline()->getLastValue() };
+			renderTargetPool.front()->lastTransferUse = { vktDevice->getTransferQueue()->getTimeline(),
+														  vktDevice->getTransferQueue()->getTimeline()->getLastValue() };
+		}
+
+		// most recently used first
+
+		if (found != renderTargetPool.end())
+			renderTargetPool.splice(renderTargetPool.begin(), renderTargetPool, found);
+		else
+			renderTargetPool.push_front(createRenderTargets());
+
+		RenderTargets* renderTargets = renderTargetPool.front();
+
+		vktColorAttachment = renderTargets->colorAttachment;
+		vktPostProcessSource = renderTargets->postProcessSource;
+		yuvIngest.framebuffer = renderTargets->yuvIngestFramebuffer;
+		yuvEncode.target = renderTargets->yuvEncodeTarget;
+		yuvEncode.framebuffer = renderTargets->yuvEncodeFramebuffer;
+
+		for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++)
+		{
+			frameSlots[i].vktFrameTransfer = renderTargets->frameTransfers[i];
+			frameSlots[i].vktYuvPlanes = renderTargets->yuvPlanes[i];
+			frameSlots[i].vktReadback = renderTargets->readbacks[i];
+			frameSlots[i].pendingReadback = {};
+		}
+
+		// the materials bind the texture set through this handle, the next draws bind the one of the set (the draws
+		// in flight keep the previous one, nothing is rewritten). null on the first call, _setupRendering sets it
+
+		virtualSceneData.textureSet.set = renderTargets->textureSet.set;
+
+		// the post process source doesn't hold the previous frame
+		dirtyTiles.invalidate();
+		postProcessSourceOnTransfer = false;
+
+		// least recently used sets over the budget go, never the one in use
+
+		size_t pooledBytes = 0;
+		for (RenderTargets* pooled : renderTargetPool)
+			pooledBytes += pooled->bytes;
+
+		while (pooledBytes > renderTargetPoolBudget && renderTargetPool.size() > 1)
+		{
+			RenderTargets* evicted = renderTargetPool.back();
+			renderTargetPool.pop_back();
+
+			// the transients of the evicted size go once idle (drawFrame)
+			pooledBytes -= evicted->bytes;
+			destroyRenderTargets(evicted);
+		}
+	}
+
+	void ReaShaderRenderer::destroyRenderTargets(RenderTargets* renderTargets)
+	{
+		// usually reached long ago, no queue drain
+		renderTargets->lastGraphicsUse.wait();
+		renderTargets->lastTransferUse.wait();
+
+		renderGraph->destroyFramebuffers(renderTargets->colorAttachment->getImageView());
+
+		renderTargets->deletionQueue.flush();
+		delete renderTargets;
+	}
+
+	void ReaShaderRenderer::clearRenderTargets()
+	{
+		for (RenderTargets* renderTargets : renderTargetPool)
+		{
+			// the device is idle, the timelines may be gone already
+			renderTargets->deletionQueue.flush();
+			delete renderTargets;
+		}
+		renderTargetPool.clear();
 	}
 
 	void ReaShaderRenderer::_createDefaultMeshes()
 	{
 		vktPhysicalDeviceChangedDeletionQueue.push_function([&]() { meshes.clear(); });
 
+		// immutable, loaded once per device for all the plugin instances (they live as long as the device)
+
+		std::lock_guard<std::mutex> lock(sharedDevice->resourcesMutex);
+
+		if (!sharedDevice->meshes.get(defaultIds::meshes::quad))
 		{
-			vkt::Rendering::Mesh* quad = new vkt::Rendering::Mesh(vktDevice);
+			vkt::Rendering::Mesh* quad = new vkt::Rendering::Mesh(sharedDevice->device);
 			loadQuad(quad);
-			meshes.add(defaultIds::meshes::quad, quad);
+			sharedDevice->meshes.add(defaultIds::meshes::quad, quad);
 		}
 
+		if (!sharedDevice->meshes.get(defaultIds::meshes::reashader))
 		{
-			vkt::Rendering::Mesh* reashader = new vkt::Rendering::Mesh(vktDevice);
+			vkt::Rendering::Mesh* reashader = new vkt::Rendering::Mesh(sharedDevice->device);
 			std::string path = tools::paths::join({ MESHES_DIR, "reashader.obj" });
 			reashader->load_from_obj(path);
-			meshes.add(defaultIds::meshes::reashader, reashader);
+			sharedDevice->meshes.add(defaultIds::meshes::reashader, reashader);
 		}
 
+		meshes = sharedDevice->meshes;
+
 	}
 	void ReaShaderRenderer::_createDefaultTextures()
 	{
-		vkSampler = vkt::textures::createSampler(vktDevice, VK_FILTER_LINEAR);
-
 		vktPhysicalDeviceChangedDeletionQueue.push_function([&]() { textures.clear(); });
 
+		// immutable, like the meshes
+
+		std::lock_guard<std::mutex> lock(sharedDevice->resourcesMutex);
+
+		if (!sharedDevice->sampler)
+			sharedDevice->sampler = vkt::textures::createSampler(sharedDevice->device, VK_FILTER_LINEAR);
+		vkSampler = sharedDevice->sampler;
+
+		if (!sharedDevice->textures.get(defaultIds::textures::logo))
 		{
-			vkt::Images::AllocatedImage* texture = new vkt::Images::AllocatedImage(vktDevice);
+			vkt::Images::AllocatedImage* texture = new vkt::Images::AllocatedImage(sharedDevice->device);
 			texture->createImage(tools::paths::join({ IMAGES_DIR, "reashader-logo-hr.png" }), VK_ACCESS_SHADER_READ_BIT,
 								 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 			texture->createImageView(VK_IMAGE_VIEW_TYPE_2D, texture->getFormat(), VK_IMAGE_ASPECT_COLOR_BIT);
-			textures.add(defaultIds::textures::logo, texture);
+			sharedDevice->textures.add(defaultIds::textures::logo, texture);
 		}
+
+		textures = sharedDevice->textures;
 	}
 
 	void ReaShaderRenderer::_setupRendering()
 	{
 		// renderpass
 		vkRenderPass = createRenderPass(vktDevice);
+		yuvIngest.renderPass = createFrameConversionRenderPass(vktDevice, VK_FORMAT_B8G8R8A8_UNORM);
+		yuvEncode.renderPass = createFrameConversionRenderPass(vktDevice, VK_FORMAT_R8_UNORM);
+		postProcessChain.renderPass = createPostProcessRenderPass(vktDevice);
 
-		// initialize render targets
-		createRenderTargets();
+		// initialize render targets (the texture set layout of the previous device is gone, the set is written below)
+		virtualSceneData.textureSet = {};
+		useRenderTargets();
 
 		// create default resources
 
@@ -1164,13 +3210,18 @@ namespace ReaShader
 
 		// buffers/descriptors
 
-		// declare types and needs
-		vktDescriptorPool = new vkt::Descriptors::DescriptorPool(vktDevice,
-																 { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5 },
-																   { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 5 },
-																   { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 },
-																   { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5 } },
-																 5);
+		// declare types and needs (plus the chain inputs of every post process pass and the scene draws, per frame
+		// slot) (graphics and compute)
+		constexpr int postProcessInputSets = FRAMES_IN_FLIGHT * MAX_POST_PROCESS_PASSES;
+		vktDescriptorPool = new vkt::Descriptors::DescriptorPool(
+			vktDevice,
+			{ { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5 },
+			  { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 5 },
+			  { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 + 5 * FRAMES_IN_FLIGHT },
+			  { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				5 + 2 * postProcessInputSets * (1 + MAX_POST_PROCESS_INPUTS) },
+			  { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, postProcessInputSets } },
+			5 + 2 * postProcessInputSets + 2 * FRAMES_IN_FLIGHT);
 
 		// bind sets
 
@@ -1182,7 +3233,7 @@ namespace ReaShader
 											   VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 											   VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
 										 .build();
-		// set 1
+		// set 1, the instances of the draws (per frame slot)
 		virtualSceneData.objectSet = vkt::Descriptors::DescriptorSetLayoutBuilder(vktDevice)
 										 .bind(defaultIds::descriptorBindings::object_storage_buffer,
 											   VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
@@ -1193,24 +3244,88 @@ namespace ReaShader
 												VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
 										  .bind(defaultIds::descriptorBindings::sampled_frame,
 												VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+										  .bind(defaultIds::descriptorBindings::input_layers,
+												VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
 										  .build();
 
-		vktDescriptorPool->allocateDescriptorSets(
-			{ virtualSceneData.globalSet, virtualSceneData.objectSet, virtualSceneData.textureSet });
+		// yuv ingest set
+		yuvIngest.planesSet = vkt::Descriptors::DescriptorSetLayoutBuilder(vktDevice)
+								  .bind(defaultIds::descriptorBindings::frame_planes_storage_buffer,
+										VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+								  .build();
+
+		// yuv encode set
+		yuvEncode.sourceSet = vkt::Descriptors::DescriptorSetLayoutBuilder(vktDevice)
+								  .bind(defaultIds::descriptorBindings::rendered_frame,
+										VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+								  .build();
+
+		// post process chain inputs (set 1 of the pass materials), previous pass output then named intermediates
+		postProcessChain.inputSet = vkt::Descriptors::DescriptorSetLayoutBuilder(vktDevice)
+										.bind(defaultIds::descriptorBindings::post_process_inputs,
+											  VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT,
+											  1 + MAX_POST_PROCESS_INPUTS)
+										.build();
+
+		// compute post process passes, chain inputs then the target
+		postProcessChain.computeSet = vkt::Descriptors::DescriptorSetLayoutBuilder(vktDevice)
+										  .bind(defaultIds::descriptorBindings::post_process_inputs,
+												VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT,
+												1 + MAX_POST_PROCESS_INPUTS)
+										  .bind(defaultIds::descriptorBindings::post_process_target,
+												VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+										  .build();
+
+		// culling of the scene, objects in and draws out
+		scene.cullSet = vkt::Descriptors::DescriptorSetLayoutBuilder(vktDevice)
+							.bind(defaultIds::descriptorBindings::cull_objects, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+								  VK_SHADER_STAGE_COMPUTE_BIT)
+							.bind(defaultIds::descriptorBindings::cull_commands, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+								  VK_SHADER_STAGE_COMPUTE_BIT)
+							.bind(defaultIds::descriptorBindings::cull_counts, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+								  VK_SHADER_STAGE_COMPUTE_BIT)
+							.bind(defaultIds::descriptorBindings::cull_instances, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+								  VK_SHADER_STAGE_COMPUTE_BIT)
+							.build();
+
+		// the texture sets are per render targets
+		vktDescriptorPool->allocateDescriptorSets({ virtualSceneData.globalSet, yuvIngest.planesSet,
+													yuvEncode.sourceSet });
+
+		for (FrameSlot& frameSlot : frameSlots)
+		{
+			std::vector<std::reference_wrapper<vkt::Descriptors::DescriptorSet>> inputSets;
+			for (vkt::Descriptors::DescriptorSet& inputSet : frameSlot.postProcessInputSets)
+			{
+				inputSet = postProcessChain.inputSet;
+				inputSets.push_back(inputSet);
+			}
+			for (vkt::Descriptors::DescriptorSet& computeSet : frameSlot.postProcessComputeSets)
+			{
+				computeSet = postProcessChain.computeSet;
+				inputSets.push_back(computeSet);
+			}
+			// written when the slot first draws the scene
+			frameSlot.sceneDraws.cullSet = scene.cullSet;
+			frameSlot.sceneDraws.instanceSet = virtualSceneData.objectSet;
+			inputSets.push_back(frameSlot.sceneDraws.cullSet);
+			inputSets.push_back(frameSlot.sceneDraws.instanceSet);
+			vktDescriptorPool->allocateDescriptorSets(inputSets);
+		}
 
 		// create buffers and images to bind
 
+		// written every frame, persistently mapped
+
 		virtualSceneData.cameraBuffer = new vkt::Buffers::AllocatedBuffer(vktDevice);
-		virtualSceneData.cameraBuffer->allocate(sizeof(VirtualCameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-												VMA_MEMORY_USAGE_CPU_TO_GPU);
+		virtualSceneData.cameraBuffer->allocate(
+			sizeof(VirtualCameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+			VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
 
 		virtualSceneData.sceneBuffer = new vkt::Buffers::AllocatedBuffer(vktDevice);
-		virtualSceneData.sceneBuffer->allocate(sizeof(VirtualEnvironmentData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-											   VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-		virtualSceneData.objectBuffer = new vkt::Buffers::AllocatedBuffer(vktDevice);
-		virtualSceneData.objectBuffer->allocate(sizeof(RenderObjectData) * MAX_OBJECTS,
-												VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		virtualSceneData.sceneBuffer->allocate(
+			sizeof(VirtualEnvironmentData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+			VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
 
 		// write resources pointers to descriptor sets
 
@@ -1220,32 +3335,56 @@ namespace ReaShader
 			.registerWriteBuffer(virtualSceneData.cameraBuffer, sizeof(VirtualCameraData), 0)
 			.selectBinding(defaultIds::descriptorBindings::global_uniform_buffer_dynamic)
 			.registerWriteBuffer(virtualSceneData.sceneBuffer, sizeof(VirtualEnvironmentData), 0)
-
-			.selectDescriptorSet(virtualSceneData.objectSet)
-			.selectBinding(defaultIds::descriptorBindings::object_storage_buffer)
-			.registerWriteBuffer(virtualSceneData.objectBuffer, sizeof(RenderObjectData) * MAX_OBJECTS, 0)
-
-			.selectDescriptorSet(virtualSceneData.textureSet)
-			.selectBinding(defaultIds::descriptorBindings::texture_combined_image_sampler)
-			.registerWriteImage(*textures.get(defaultIds::textures::logo), vkSampler,
-								VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-			.selectBinding(defaultIds::descriptorBindings::sampled_frame)
-			.registerWriteImage(vktPostProcessSource, vkSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-
 			.writeRegistered();
 
+		// the render targets created before the layout
+		for (RenderTargets* renderTargets : renderTargetPool)
+			if (!renderTargets->textureSet.set)
+				writeTextureSet(renderTargets);
+		virtualSceneData.textureSet.set = renderTargetPool.front()->textureSet.set;
+
 		// Materials
 
 		vktPhysicalDeviceChangedDeletionQueue.push_function([&]() { materials.clear(); });
 
-		// post process
+		// post process chain, built now so the first frame doesn't compile them
+		vktPhysicalDeviceChangedDeletionQueue.push_function([&]() {
+			postProcessChain.materials.clear();
+			postProcessChain.computeMaterials.clear();
+		});
+
+		for (const PostProcessPass& pass : postProcessChain.passes)
+			if (!pass.compute || postProcessChain.computeSupported)
+				getPostProcessMaterial(pass);
+
+		// yuv to rgb
+		{
+			vkt::Rendering::Material material_yuv = createMaterialFrameConversion(
+				vktDevice, yuvIngest.renderPass, { yuvIngest.planesSet.layout }, "yuv_frag.glsl");
+
+			material_yuv.registerBindDescriptorSets(0, 1, &(yuvIngest.planesSet.set), 0, nullptr);
+
+			materials.add(defaultIds::materials::yuv_to_rgb, std::move(material_yuv));
+		}
+
+		// rgb to yuv
+		{
+			vkt::Rendering::Material material_yuv_encode = createMaterialFrameConversion(
+				vktDevice, yuvEncode.renderPass, { yuvEncode.sourceSet.layout }, "yuv_encode_frag.glsl");
+
+			material_yuv_encode.registerBindDescriptorSets(0, 1, &(yuvEncode.sourceSet.set), 0, nullptr);
+
+			materials.add(defaultIds::materials::rgb_to_yuv, std::move(material_yuv_encode));
+		}
+
+		// dry mix
 		{
-			vkt::Rendering::Material material_post_process =
-				createMaterialPP(vktDevice, vkRenderPass, { virtualSceneData.textureSet.layout });
+			vkt::Rendering::Material material_dry_mix =
+				createMaterialDryMix(vktDevice, vkRenderPass, { virtualSceneData.textureSet.layout });
 
-			material_post_process.registerBindDescriptorSets(0, 1, &(virtualSceneData.textureSet.set), 0, nullptr);
+			material_dry_mix.registerBindDescriptorSets(0, 1, &(virtualSceneData.textureSet.set), 0, nullptr);
 
-			materials.add(defaultIds::materials::post_process, std::move(material_post_process));
+			materials.add(defaultIds::materials::dry_mix, std::move(material_dry_mix));
 		}
 
 		std::vector<uint32_t> dynamicOffsets = {
@@ -1262,7 +3401,6 @@ namespace ReaShader
 			material_opaque
 				.registerBindDescriptorSets(0, 1, &virtualSceneData.globalSet.set,
 											static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data())
-				.registerBindDescriptorSets(1, 1, &virtualSceneData.objectSet.set, 0, nullptr)
 				.registerBindDescriptorSets(2, 1, &(virtualSceneData.textureSet.set), 0, nullptr);
 
 			materials.add(defaultIds::materials::opaque, std::move(material_opaque));
@@ -1272,13 +3410,6 @@ namespace ReaShader
 
 		vktPhysicalDeviceChangedDeletionQueue.push_function([&]() { renderObjects.clear(); });
 
-		{
-			vkt::Rendering::RenderObject pp{};
-			pp.mesh = *meshes.get(defaultIds::meshes::quad);
-			pp.material = materials.get(defaultIds::materials::post_process);
-			renderObjects.push_back(std::move(pp));
-		}
-
 		{
 			vkt::Rendering::RenderObject reashader{};
 			reashader.mesh = *meshes.get(defaultIds::meshes::reashader);
@@ -1302,13 +3433,60 @@ namespace ReaShader
 			triangle.localTransformMatrix = translation * scale;
 			renderObjects.push_back(std::move(triangle));*/
 		}
+
+		// culled into indirect draws, an object per invocation
+
+		if (scene.supported)
+			scene.cullMaterial = createMaterialCompute(vktDevice, { scene.cullSet.layout }, "cull_comp.glsl", "",
+													   sizeof(CullPushConstants), { 64, 1 });
+
+		updateScene();
+	}
+
+	vkt::Rendering::Material* ReaShaderRenderer::getPostProcessMaterial(const PostProcessPass& pass)
+	{
+		if (pass.compute)
+		{
+			auto found = postProcessChain.computeMaterials.find(pass.shader);
+			if (found != postProcessChain.computeMaterials.end())
+				return &found->second;
+
+			// the set is bound per pass when recorded
+			vkt::Rendering::Material material = createMaterialCompute(
+				vktDevice, { postProcessChain.computeSet.layout }, pass.shader, postProcessChain.computeDefines);
+
+			return &postProcessChain.computeMaterials.emplace(pass.shader, std::move(material)).first->second;
+		}
+
+		auto found = postProcessChain.materials.find(pass.shader);
+		if (found != postProcessChain.materials.end())
+			return &found->second;
+
+		// fused per pixel kernels are generated, compiled once per signature
+
+		VkShaderModule fragShaderModule =
+			pass.pixel ? vkt::Pipeline::createShaderModule(vktDevice, EShLangFragment, generatePixelKernel(pass.shader))
+					   : vkt::Pipeline::createShaderModule(vktDevice, EShLangFragment,
+														   tools::paths::join({ SHADERS_DIR, pass.shader }));
+
+		vkt::Rendering::Material material = createMaterialPP(
+			vktDevice, postProcessChain.renderPass,
+			{ virtualSceneData.textureSet.layout, postProcessChain.inputSet.layout }, fragShaderModule);
+
+		// set 1 is bound per pass when recorded
+		material.registerBindDescriptorSets(0, 1, &(virtualSceneData.textureSet.set), 0, nullptr);
+
+		return &postProcessChain.materials.emplace(pass.shader, std::move(material)).first->second;
 	}
 
 	void ReaShaderRenderer::_cleanupVulkan()
 	{
-		vktDevice->waitIdle();
+		FrameHandoff::retire(this);
+
+		vktDevice->getGraphicsQueue()->waitSubmitted();
+		vktDevice->getTransferQueue()->waitSubmitted();
 		// flush deletion queues in reverse order
-		vktFrameResizedDeletionQueue.flush();
+		clearRenderTargets();
 		vktPhysicalDeviceChangedDeletionQueue.flush();
 		vktMainDeletionQueue.flush();
 	}
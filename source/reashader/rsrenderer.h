@@ -8,13 +8,30 @@
 
 #pragma once
 
+#include "rsdevicemanager.h"
+#include "rsdirtytiles.h"
+#include "rsframehandoff.h"
 #include "tools/fwd_decl.h"
 
 #include "vkt/vktcommon.h"
 #include "vkt/vktdescriptors.h"
 #include "vkt/vktdevices.h"
+#include "vkt/vktframecontext.h"
+#include "vkt/vktrendergraph.h"
 #include "vkt/vktimages.h"
 #include "vkt/vktrendering.h"
+#include "vkt/vkttimeline.h"
+
+#include <list>
+#include <mutex>
+
+// number of frame slots the renderer cycles through (2 or 3)
+#define FRAMES_IN_FLIGHT 2
+// video processor inputs the shaders can sample as layers of a 2d array (input 0 is the processed frame)
+#define MAX_FRAME_INPUTS 4
+// passes of the post process chain, and named intermediates a pass can sample
+#define MAX_POST_PROCESS_PASSES 8
+#define MAX_POST_PROCESS_INPUTS 4
 
 namespace ReaShader
 {
@@ -36,14 +53,150 @@ class ReaShaderRenderer
 
     void changeRenderingDevice(int renderingDeviceIndex);
 
+    bool isHalted()
+    {
+        return halted;
+    }
+
+    // held by the video thread while it drives the renderer, and by the readbacks of the handed off frames that a
+    // consumer runs from its thread (frame slots, current slot and frame contexts)
+    std::mutex frameMutex;
+
     // public functions that drive the renderer, asynchronously called
     // make sure to invalidate the device if there's a device change in progress
     void checkFrameSize(int &w, int &h, void (*listener)() = nullptr);
-    void loadBitsToImage(int *srcBuffer);
+    // an extra input of the video processor (rgba), any size
+    struct FrameInput
+    {
+        const int *bits;
+        int w, h, rowspan;
+    };
+    // inputs 1 onwards for the next loadBitsToImage, copied by it (the frames can be released right after)
+    // all the inputs go to the input layers in one batch, layer i is input i
+    void setFrameInputs(const FrameInput *inputs, int count);
+    // fmt is the video frame format ('RGBA', 'YV12', 'YUY2'), yuv frames are converted to rgb on the gpu
+    // returns true if the gpu still reads srcBuffer (keep the frame alive until transferFrame or finishReadback),
+    // false if it can be released right away
+    bool loadBitsToImage(int *srcBuffer, int fmt = 'RGBA', int rowspan = 0);
     // called inside drawFrame to update the general scene parameters to pass to the shaders
 	void updateVirtualScene(double pushConstants[]);
+    // pushConstants are project time, frame rate, video param and wet amount (below 1 the input frame is mixed back in)
 	void drawFrame(double pushConstants[]);
-    void transferFrame(int *&destBuffer);
+	// the scene render pass of drawFrame
+	void recordScene(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, VkExtent2D extent,
+					 double pushConstants[]);
+    // fmt and rowspan are the ones of the destination video frame, yuv frames are encoded on the gpu
+    // returns false if nothing was written (renderer halted)
+    bool transferFrame(int *&destBuffer, int fmt = 'RGBA', int rowspan = 0);
+    // transferFrame in two steps, so the cpu can work while the gpu reads back
+    // returns the slot to poll and finish (destBuffer is written by finishReadback), -1 if halted
+    int submitReadback(int *destBuffer, int fmt = 'RGBA', int rowspan = 0);
+    // doesn't block, true once finishReadback won't wait for the gpu
+    bool isReadbackReady(int slot);
+    // waits for the readback if needed, then copies the frame out (must be called before the slot is reused)
+    void finishReadback(int slot);
+
+    // gpu hand-off between chained instances on the same device (rgba frames only)
+
+    // takes back the frame published by the previous call, at the start of every frame
+    void retireHandedOffFrame();
+    // the input in srcBuffer was rendered by the previous instance on this device and is still on the gpu, the next
+    // loadHandedOffFrame copies it instead of uploading srcBuffer (whose bits may be stale)
+    bool claimHandedOffFrame(const int *srcBuffer);
+    // the bits of the claimed frame were not read back, only the gpu copy holds it
+    bool isHandedInFrameStale()
+    {
+        return static_cast<bool>(handedInFrame.readBack);
+    }
+    // loadBitsToImage for a claimed frame
+    bool loadHandedOffFrame();
+    // the last published frame was copied on the gpu by the next instance, the next one can be handed off without
+    // readback if it goes straight to that instance
+    bool isHandOffClaimed()
+    {
+        return handOffConsumer != nullptr;
+    }
+    // the renderer of the instance that copied it (null if none)
+    const void *getHandOffConsumer()
+    {
+        return handOffConsumer;
+    }
+    // instead of the readback, the bits of frame are written only if a consumer can't use the gpu frame
+    // returns false if nothing was handed off (renderer halted)
+    bool handOffFrame(IVideoFrame *frame);
+    // after the readback of frame in slot, so the next instance can copy the image instead of the bits
+    void publishFrame(IVideoFrame *frame, int slot);
+
+    // color matrix used for yuv frames, auto picks BT.709 for hd frames and BT.601 otherwise
+    enum class YuvColorMatrix
+    {
+        Auto,
+        BT601,
+        BT709
+    };
+    void setYuvColorMatrix(YuvColorMatrix matrix)
+    {
+        yuvColorMatrix = matrix;
+    }
+
+    // share of the 64x64 tiles uploaded by the last loadBitsToImage (1 for full uploads), rgba frames only change
+    // the tiles that differ from the previous frame
+    float getChangedTileRatio()
+    {
+        return dirtyTiles.getChangedTileRatio();
+    }
+
+    // adaptive resolution: the effects are drawn at a reduced scale (then upscaled) while the gpu time of the draw
+    // doesn't fit the frame time, off by default and never while rendering offline
+    void setAdaptiveResolution(bool enabled)
+    {
+        adaptiveResolution.enabled = enabled;
+    }
+    void setOfflineRender(bool offline)
+    {
+        adaptiveResolution.offline = offline;
+    }
+    // a full screen pass of the post process chain
+    struct PostProcessPass
+    {
+        // in the shaders dir, a fragment shader samples the ingested frame and input layers in set 0 (as pp_frag.glsl)
+        // and the chain inputs in set 1: the previous pass output (the ingested frame for the first pass), then the
+        // named intermediates in the order of inputs
+        std::string shader;
+        std::vector<std::string> inputs;
+        // written to a named intermediate instead of the next ping-pong target (the last pass draws the frame)
+        std::string output;
+        // a compute shader instead, dispatched over the frame in 16x16 groups with the chain inputs and the rgba8
+        // storage image it writes in set 0 (as blur_comp.glsl), the SUBGROUP_* defines tell the subgroup operations
+        // it can use
+        bool compute{false};
+        // a per pixel snippet instead, defining vec4 pixel(vec4 color) (as invert_pixel.glsl): consecutive ones are
+        // fused into a single pass that reads and writes the frame once (they can't have inputs, a named output ends
+        // the run)
+        bool pixel{false};
+        // inputs of the video processor past the first one the pass samples from the input layers, only as many are
+        // fetched and uploaded (at most MAX_FRAME_INPUTS - 1)
+        int frameInputs{0};
+    };
+    // replaces the post process chain, drawn in order before the objects in the same command buffer (empty restores
+    // the default pp_frag.glsl pass), intermediates not sampled by a later pass are not drawn
+    // at most MAX_POST_PROCESS_PASSES passes once the per pixel snippets are fused
+    void setPostProcessChain(std::vector<PostProcessPass> passes);
+    // extra inputs the chain samples (the most of its passes), the ones to pass to setFrameInputs
+    int getFrameInputCount()
+    {
+        return postProcessChain.frameInputs;
+    }
+
+    // scale the next frames are drawn at, and the one of the last loaded frame
+    float getRenderScale()
+    {
+        return renderScaleLevels[adaptiveResolution.level];
+    }
+    float getLastRenderScale()
+    {
+        return lastRenderScale;
+    }
 
   private:
     bool exceptionOnInitialize{false};
@@ -59,7 +212,57 @@ class ReaShaderRenderer
     //-----------------------------------------------
 
     void setUpDevice(int renderingDeviceIndex);
-    void createRenderTargets();
+
+    static constexpr uint32_t renderScaleLevelCount = 3;
+    static constexpr float renderScaleLevels[renderScaleLevelCount]{1.f, 0.75f, 0.5f};
+
+    // everything that depends on the frame size, pooled per size so going back to a recent size is cheap
+    struct RenderTargets
+    {
+        uint32_t w, h;
+        VkFormat format;
+        // device and host memory held (estimate)
+        size_t bytes;
+        // destroys the set
+        vkt::deletion_queue deletionQueue;
+        // the last submissions that may have used the set, waited for before destroying it
+        vkt::TimelinePoint lastGraphicsUse, lastTransferUse;
+
+        vkt::Images::AllocatedImage *colorAttachment, *postProcessSource;
+        VkFramebuffer yuvIngestFramebuffer;
+        vkt::Images::AllocatedImage *yuvEncodeTarget;
+        VkFramebuffer yuvEncodeFramebuffer;
+        // per frame slot
+        std::array<vkt::Images::AllocatedImage *, FRAMES_IN_FLIGHT> frameTransfers;
+        std::array<vkt::Buffers::AllocatedBuffer *, FRAMES_IN_FLIGHT> yuvPlanes;
+        std::array<vkt::Buffers::AllocatedBuffer *, FRAMES_IN_FLIGHT> readbacks;
+        // all the inputs of the video processor, frame size, sampled as a 2d array
+        vkt::Images::AllocatedImage *inputLayers;
+        // the layers have been transitioned at least once (sampled layout)
+        bool inputLayersReady;
+        // extra inputs packed at frame size (one per slot), created on the first frame with more than one input
+        std::array<vkt::Buffers::AllocatedBuffer *, FRAMES_IN_FLIGHT> inputStaging;
+        // set 2 of the draws sampling the post process source and input layers above, bound while the set is in use
+        // (written once, the draws still bound to another size keep theirs)
+        VkDescriptorPool descriptorPool;
+        vkt::Descriptors::DescriptorSet textureSet;
+    };
+
+    // most recently used first, the first one is in use
+    std::list<RenderTargets *> renderTargetPool;
+    // least recently used sets are destroyed above this (the one in use is always kept)
+    size_t renderTargetPoolBudget{768ull << 20};
+
+    RenderTargets *createRenderTargets();
+    // allocates and writes the texture set of the render targets (once the layout and the textures exist)
+    void writeTextureSet(RenderTargets *renderTargets);
+    // makes the set for the current frame size the one in use, creates it if it's not pooled
+    void useRenderTargets();
+    void destroyRenderTargets(RenderTargets *renderTargets);
+    // device change and shutdown (device idle)
+    void clearRenderTargets();
+    // of the set in use, the targets of a scale level are transients of the render graph
+    VkExtent2D getScaledExtent(uint32_t level);
 
     // create defalt resources
 	void _createDefaultMeshes();
@@ -70,26 +273,246 @@ class ReaShaderRenderer
 
     VkInstance myVkInstance;
     vkt::deletion_queue vktMainDeletionQueue{};
-    vkt::deletion_queue vktFrameResizedDeletionQueue{};
     vkt::deletion_queue vktPhysicalDeviceChangedDeletionQueue{};
 
+    // process wide, vktDevice is the handle of this renderer to it
+    DeviceManager::SharedDevice *sharedDevice;
+
     vkt::Physical::Device *vktPhysicalDevice;
     vkt::Logical::Device *vktDevice;
 
-    vkt::Images::AllocatedImage *vktFrameTransfer;
     vkt::Images::AllocatedImage *vktPostProcessSource;
     vkt::Images::AllocatedImage *vktColorAttachment;
-    vkt::Images::AllocatedImage *vktDepthAttachment;
 
     VkRenderPass vkRenderPass;
-    VkFramebuffer vkFramebuffer;
 
-    VkCommandBuffer vkDrawCommandBuffer;
-    VkCommandBuffer vkTransferCommandBuffer;
+    // the passes of drawFrame, with the depth and scaled color attachments as transients
+    vkt::RenderGraph *renderGraph;
+
+    // everything a frame needs while in flight, so consecutive frames don't have to drain the queue
+    struct FrameSlot
+    {
+        // staging image, mapped (upload)
+        vkt::Images::AllocatedImage *vktFrameTransfer;
+        // video frame bits imported as buffers (zero copy path), released when the slot is done
+        vkt::Buffers::ImportedHostBuffer *vktImportedFrame;
+        vkt::Buffers::ImportedHostBuffer *vktImportedOutputFrame;
+        // yuv planes of the video frame, read by the yuv to rgb pass
+        vkt::Buffers::AllocatedBuffer *vktYuvPlanes;
+        // rendered rgba frame or encoded yuv planes, host cached and persistently mapped (readback)
+        vkt::Buffers::AllocatedBuffer *vktReadback;
+
+        // upload, draw and readback command buffers (on the dedicated transfer queue: host to device copies,
+        // device to host copies, and the graphics side release of the color attachment before the readback)
+        vkt::FrameContext *frameContext;
+
+        // points on the queue timelines signaled by the submissions of the frame, each submission waits for the
+        // previous one
+        vkt::TimelinePoint uploaded;
+        vkt::TimelinePoint rendered;
+        // the readback has completed, the slot can be reused
+        vkt::TimelinePoint readBack;
+
+        // chain inputs of each post process pass, written when the pass is recorded
+        std::array<vkt::Descriptors::DescriptorSet, MAX_POST_PROCESS_PASSES> postProcessInputSets;
+        std::array<vkt::Descriptors::DescriptorSet, MAX_POST_PROCESS_PASSES> postProcessComputeSets;
+
+        // the render objects as the culling reads them, and the indirect draws it writes for the scene pass, grown
+        // with the scene and rewritten when it changes
+        struct SceneDraws
+        {
+            // host visible, mapped
+            vkt::Buffers::AllocatedBuffer *objects;
+            vkt::Buffers::AllocatedBuffer *commands;
+            // draw count of each batch
+            vkt::Buffers::AllocatedBuffer *counts;
+            // model matrix of each draw
+            vkt::Buffers::AllocatedBuffer *instances;
+            // objects (and draws) the buffers hold
+            uint32_t capacity;
+            // of the scene in the objects buffer
+            uint64_t version;
+            vkt::Descriptors::DescriptorSet cullSet;
+            // set 1 of the scene materials
+            vkt::Descriptors::DescriptorSet instanceSet;
+        } sceneDraws{};
+
+        // scale level the frame is drawn at, and whether the draw wrote its timestamps
+        uint32_t scaleLevel;
+        bool timed;
+        // valid input layers for the draw (1 if only the processed frame, then the layers are not updated)
+        uint32_t inputCount;
+
+        // submitted by submitReadback, copied out by finishReadback
+        struct PendingReadback
+        {
+            int *destBuffer;
+            int fmt;
+            int rowspan;
+            // the gpu wrote destBuffer directly
+            bool imported;
+            bool pending;
+        } pendingReadback{};
+    };
+
+    // frame ingest/readback paths, chosen at device set up depending on the available extensions
+    struct FrameIOPaths
+    {
+        // the ingested frame is written from the host straight into the post process source
+        bool hostImageCopy;
+        // the gpu copies from/to the video frame bits, no staging memcpy
+        bool importHostMemory;
+        // copies run on the dedicated transfer queue (a different queue family than graphics)
+        bool transferQueue;
+    } frameIOPaths{};
+
+    // the post process source was released to the transfer queue family by the last draw, its contents can be kept
+    bool postProcessSourceOnTransfer{false};
+
+    struct AdaptiveResolution
+    {
+        bool enabled;
+        bool offline;
+        // blits with linear filter and timestamps on the graphics queue
+        bool supported;
+        uint32_t level;
+        // gpu time of the draw (moving average) at the current level, and the frame time it has to fit in
+        double drawMs;
+        uint32_t samples;
+        double frameBudgetMs;
+        // nanoseconds per timestamp tick
+        float timestampPeriod;
+        // begin and end of the draw, per frame slot
+        VkQueryPool queryPool;
+    } adaptiveResolution{};
+
+    float lastRenderScale{1.f};
+
+    // set by setFrameInputs, consumed by the next loadBitsToImage
+    std::array<FrameInput, MAX_FRAME_INPUTS - 1> pendingInputs{};
+    uint32_t pendingInputCount{0};
+
+    // packs the pending inputs into the staging of the slot and records their upload, with the processed frame
+    // (post process source, transfer src) copied to layer 0
+    void recordInputLayers(VkCommandBuffer commandBuffer, FrameSlot &frameSlot);
+
+    // frame hand-off state: the claimed input, and who claimed the last output (and the copy to wait for)
+    FrameHandoff::Frame handedInFrame{};
+    const void *handOffConsumer{nullptr};
+    vkt::TimelinePoint handOffConsumed{};
+
+    // readback of a handed off frame for a consumer that needs the bits (the frame is still in the color attachment),
+    // called from the consumer thread
+    void readBackHandedOffFrame(int *destBuffer, int rowspan, vkt::TimelinePoint rendered);
+
+    // reads the draw timestamps of the slot and moves the scale level
+    void updateRenderScale(uint32_t slot);
 
-    VkSemaphore vkImageAvailableSemaphore;
-    VkSemaphore vkRenderFinishedSemaphore;
-    VkFence vkInFlightFence;
+    // the render objects are drawn by indirect commands a compute pass writes: the objects outside of the frustum
+    // are culled on the gpu, those with the same material and mesh are a batch, drawn with one call
+    struct SceneBatch
+    {
+        vkt::Rendering::Material *material;
+        vkt::Rendering::Mesh *mesh;
+        // indices, or vertices for the meshes without index buffer
+        bool indexed;
+        uint32_t elementCount;
+        // range of the batch in the draws
+        uint32_t firstDraw;
+        uint32_t maxDraws;
+    };
+    struct Scene
+    {
+        // objects ordered by batch
+        std::vector<uint32_t> order;
+        std::vector<SceneBatch> batches;
+        // bumped by updateScene, the slots rewrite their objects when they are behind
+        uint64_t version;
+        // the culling runs on the graphics queue, the objects are not drawn otherwise
+        bool supported;
+        // the gpu writes the draw counts (VK_KHR_draw_indirect_count), and a call can draw many (multiDrawIndirect),
+        // otherwise the batches are drawn by as many calls as their max draws, the culled ones empty
+        bool indirectCount;
+        bool multiDraw;
+        // layout of the culling, objects, draws, counts and instances
+        vkt::Descriptors::DescriptorSet cullSet;
+        vkt::Rendering::Material cullMaterial;
+    } scene{};
+
+    // after renderObjects changed
+    void updateScene();
+    // grows the buffers of the slot to the scene and writes its objects, if behind
+    void prepareSceneDraws(FrameSlot &frameSlot);
+    // clears the counts, then culls into the draws of the slot
+    void recordCulling(VkCommandBuffer commandBuffer, FrameSlot &frameSlot, double pushConstants[]);
+
+    // native yuv frames are drawn as rgb into the post process source
+    struct YuvIngest
+    {
+        VkRenderPass renderPass;
+        VkFramebuffer framebuffer;
+        vkt::Descriptors::DescriptorSet planesSet;
+    } yuvIngest{};
+
+    // the rendered frame is encoded into a r8 target laid out like the yuv planes
+    struct YuvEncode
+    {
+        VkRenderPass renderPass;
+        VkFramebuffer framebuffer;
+        vkt::Images::AllocatedImage *target;
+        vkt::Descriptors::DescriptorSet sourceSet;
+    } yuvEncode{};
+
+    YuvColorMatrix yuvColorMatrix{YuvColorMatrix::Auto};
+
+    // full screen passes ping-ponging between two transients of the render graph, the last one draws into the scene
+    // color before the objects
+    struct PostProcessChain
+    {
+        // as drawn, the shader of a fused per pixel pass is its signature (the snippets joined by +)
+        std::vector<PostProcessPass> passes{{"pp_frag.glsl"}};
+        int frameInputs{0};
+        VkRenderPass renderPass;
+        // layout of the chain inputs (set 1)
+        vkt::Descriptors::DescriptorSet inputSet;
+        // layout of the compute passes, chain inputs and target
+        vkt::Descriptors::DescriptorSet computeSet;
+        // dispatches on the graphics queue, compute passes are skipped otherwise
+        bool computeSupported;
+        // subgroup capabilities, prepended to the compute shaders
+        std::string computeDefines;
+        // by shader (or signature of the fused snippets), built on first use on the device
+        std::map<std::string, vkt::Rendering::Material> materials;
+        std::map<std::string, vkt::Rendering::Material> computeMaterials;
+    } postProcessChain{};
+
+    vkt::Rendering::Material *getPostProcessMaterial(const PostProcessPass &pass);
+    // inputs are the previous pass output and the named intermediates (sampled), target the written image
+    void recordPostProcessPass(VkCommandBuffer commandBuffer, vkt::Rendering::Material *material,
+                               vkt::Descriptors::DescriptorSet inputSet, vkt::RenderGraph::Resource target,
+                               std::array<vkt::RenderGraph::Resource, 1 + MAX_POST_PROCESS_INPUTS> inputs,
+                               VkExtent2D extent, double pushConstants[]);
+    // target is a storage image (general layout)
+    void recordPostProcessDispatch(VkCommandBuffer commandBuffer, vkt::Rendering::Material *material,
+                                   vkt::Descriptors::DescriptorSet computeSet, vkt::RenderGraph::Resource target,
+                                   std::array<vkt::RenderGraph::Resource, 1 + MAX_POST_PROCESS_INPUTS> inputs,
+                                   VkExtent2D extent, double pushConstants[]);
+
+    // tiles of the rgba frames, only the changed ones are written to the post process source
+    DirtyTileTracker dirtyTiles;
+
+    bool yuvUsesBT709()
+    {
+        return yuvColorMatrix == YuvColorMatrix::BT709 || (yuvColorMatrix == YuvColorMatrix::Auto && FRAME_H >= 720);
+    }
+
+    std::array<FrameSlot, FRAMES_IN_FLIGHT> frameSlots{};
+    uint32_t currentFrameSlot{0};
+
+    FrameSlot &getCurrentFrameSlot()
+    {
+        return frameSlots[currentFrameSlot];
+    }
 
     vkt::vectors::searchable_map<int, vkt::Rendering::Mesh *> meshes;
     vkt::vectors::searchable_map<int, vkt::Rendering::Material> materials;
@@ -105,9 +528,9 @@ class ReaShaderRenderer
     {
         vkt::Buffers::AllocatedBuffer *cameraBuffer;
         vkt::Buffers::AllocatedBuffer *sceneBuffer;
-        vkt::Buffers::AllocatedBuffer *objectBuffer;
 
         vkt::Descriptors::DescriptorSet globalSet;
+        // layout of the instances of the draws, per frame slot
         vkt::Descriptors::DescriptorSet objectSet;
         vkt::Descriptors::DescriptorSet textureSet;
     } virtualSceneData{};
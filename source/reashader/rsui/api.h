@@ -41,6 +41,7 @@ namespace ReaShader
 			RenderingDeviceChange,
 			ParamAdd,
 			ParamTypesList,
+			PostProcessChainChange,
 
 			numMessageTypes
 		};
@@ -57,7 +58,8 @@ namespace ReaShader
 												   "renderingDevicesList",
 												   "renderingDeviceChange",
 												   "paramAdd",
-												   "paramTypesList"
+												   "paramTypesList",
+												   "postProcessChainChange"
 		};
 
 		/**
@@ -177,6 +179,20 @@ namespace ReaShader
 				return *this;
 			}
 
+			/**
+			 * @brief passes is an array of { shader, inputs, output, compute, pixel, frameInputs } (as
+			 * ReaShaderRenderer::PostProcessPass), only shader is required
+			 */
+			MessageHandler& reactToPostProcessChainChange(const std::function<void(const json& passes)>& callback)
+			{
+				if (!(_hasField("passes") && msg["passes"].is_array()))
+					return *this;
+
+				_reactTo(MessageType::PostProcessChainChange, [&](const json& msg) { callback(msg["passes"]); });
+
+				return *this;
+			}
+
 			MessageHandler& reactToRequest(const std::function<void(RequestType)>& callback)
 			{
 				if (!(_hasField("what")))
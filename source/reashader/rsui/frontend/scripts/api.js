@@ -201,6 +201,19 @@ export class Messager {
         return this;
     }
 
+    // passes: [{ shader, inputs, output, compute, pixel, frameInputs }], only shader is required, e.g.
+    // [{ shader: "blur_comp.glsl", compute: true }, { shader: "levels_pixel.glsl", pixel: true }]
+    sendPostProcessChainChange(passes) {
+        let msg = {
+            type: "postProcessChainChange",
+            passes: passes
+        };
+
+        this.#_send(msg);
+
+        return this;
+    }
+
     // Add more message builders as needed
 
     //--------------------------------------------------------
@@ -34,7 +34,7 @@ namespace vkt
 		}
 
 		AllocatedBuffer* AllocatedBuffer::allocate(size_t allocSize, VkBufferUsageFlags usage,
-												   VmaMemoryUsage memoryUsage)
+												   VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags allocationFlags)
 		{
 			// allocate vertex buffer
 			VkBufferCreateInfo bufferInfo = {};
@@ -46,16 +46,24 @@ namespace vkt
 
 			VmaAllocationCreateInfo vmaallocInfo = {};
 			vmaallocInfo.usage = memoryUsage;
+			vmaallocInfo.flags = allocationFlags;
 
 			// allocate the buffer
 			VK_CHECK_RESULT(vmaCreateBuffer(vktDevice->vmaAllocator, &bufferInfo, &vmaallocInfo, &(this->buffer),
-											&(this->allocation), nullptr));
+											&(this->allocation), &(this->allocationInfo)));
 
 			return this;
 		}
 
 		AllocatedBuffer* AllocatedBuffer::putData(void* data, size_t size)
 		{
+			if (allocationInfo.pMappedData)
+			{
+				memcpy(allocationInfo.pMappedData, data, size);
+				VK_CHECK_RESULT(vmaFlushAllocation(vktDevice->vmaAllocator, allocation, 0, size));
+				return this;
+			}
+
 			void* mapped;
 			
 			map(&mapped);
@@ -75,5 +83,252 @@ namespace vkt
 				VK_CHECK_RESULT(vmaFlushAllocation(vktDevice->vmaAllocator, this->allocation, 0, VK_WHOLE_SIZE));
 			delete (this);
 		}
+
+		// ImportedHostBuffer
+
+		ImportedHostBuffer::ImportedHostBuffer(Logical::Device* vktDevice, bool pushToDeletionQueue)
+			: vktDevice(vktDevice)
+		{
+			if (pushToDeletionQueue)
+				vktDevice->pDeletionQueue->push_function([=]() { destroy(); });
+		}
+
+		bool ImportedHostBuffer::isSupported(Logical::Device* vktDevice)
+		{
+			return vktDevice->extensionEnabled(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) &&
+				   vktDevice->physicalDevice->minImportedHostPointerAlignment > 0 &&
+				   vktDevice->ext.getMemoryHostPointerProperties;
+		}
+
+		bool ImportedHostBuffer::import(void* hostPointer, size_t size, VkBufferUsageFlags usage)
+		{
+			release();
+
+			if (!isSupported(vktDevice) || !hostPointer || !size)
+				return false;
+
+			// import whole pages, the range starts at offset inside the buffer
+
+			VkDeviceSize alignment = vktDevice->physicalDevice->minImportedHostPointerAlignment;
+
+			uintptr_t alignedBase = reinterpret_cast<uintptr_t>(hostPointer) & ~(uintptr_t)(alignment - 1);
+			VkDeviceSize alignedOffset = reinterpret_cast<uintptr_t>(hostPointer) - alignedBase;
+			VkDeviceSize alignedSize = (alignedOffset + size + alignment - 1) & ~(alignment - 1);
+
+			// memory types that can hold this pointer
+
+			VkMemoryHostPointerPropertiesEXT hostPointerProperties{};
+			hostPointerProperties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+
+			if (vktDevice->ext.getMemoryHostPointerProperties(
+					vktDevice->vk(), VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, (void*)alignedBase,
+					&hostPointerProperties) != VK_SUCCESS)
+				return false;
+
+			// buffer
+
+			VkExternalMemoryBufferCreateInfo externalBufferInfo{};
+			externalBufferInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+			externalBufferInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+			VkBufferCreateInfo bufferInfo{};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.pNext = &externalBufferInfo;
+			bufferInfo.size = alignedSize;
+			bufferInfo.usage = usage;
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			VK_CHECK_RESULT(vkCreateBuffer(vktDevice->vk(), &bufferInfo, nullptr, &buffer));
+
+			VkMemoryRequirements memoryRequirements;
+			vkGetBufferMemoryRequirements(vktDevice->vk(), buffer, &memoryRequirements);
+
+			VkBool32 memTypeFound = false;
+			uint32_t memoryType = vktDevice->physicalDevice->getMemoryType(
+				memoryRequirements.memoryTypeBits & hostPointerProperties.memoryTypeBits,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &memTypeFound);
+
+			if (!memTypeFound)
+			{
+				release();
+				return false;
+			}
+
+			// import
+
+			VkImportMemoryHostPointerInfoEXT importInfo{};
+			importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+			importInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+			importInfo.pHostPointer = (void*)alignedBase;
+
+			VkMemoryAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.pNext = &importInfo;
+			allocInfo.allocationSize = alignedSize;
+			allocInfo.memoryTypeIndex = memoryType;
+
+			if (vkAllocateMemory(vktDevice->vk(), &allocInfo, nullptr, &memory) != VK_SUCCESS)
+			{
+				release();
+				return false;
+			}
+
+			VK_CHECK_RESULT(vkBindBufferMemory(vktDevice->vk(), buffer, memory, 0));
+
+			this->hostPointer = hostPointer;
+			this->size = size;
+			this->offset = alignedOffset;
+
+			return true;
+		}
+
+		void ImportedHostBuffer::release()
+		{
+			if (buffer)
+				vkDestroyBuffer(vktDevice->vk(), buffer, nullptr);
+			if (memory)
+				vkFreeMemory(vktDevice->vk(), memory, nullptr);
+
+			buffer = VK_NULL_HANDLE;
+			memory = VK_NULL_HANDLE;
+			hostPointer = nullptr;
+			size = 0;
+			offset = 0;
+		}
+
+		void ImportedHostBuffer::destroy()
+		{
+			release();
+			delete (this);
+		}
+
+		// StagingRing
+
+		StagingRing::StagingRing(Logical::Device* vktDevice, VkDeviceSize capacity, bool pushToDeletionQueue)
+			: vktDevice(vktDevice), capacity(capacity)
+		{
+			if (pushToDeletionQueue)
+				vktDevice->pDeletionQueue->push_function([=]() { destroy(); });
+		}
+
+		void StagingRing::createBuffer(VkDeviceSize size, VkBuffer& buffer, VmaAllocation& allocation, void** mapped)
+		{
+			VkBufferCreateInfo bufferInfo = {};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = size;
+			bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+			// coherent, nothing to flush before the submissions
+			VmaAllocationCreateInfo vmaallocInfo = {};
+			vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+			vmaallocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			vmaallocInfo.flags =
+				VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+
+			VmaAllocationInfo allocationInfo;
+			VK_CHECK_RESULT(vmaCreateBuffer(vktDevice->vmaAllocator, &bufferInfo, &vmaallocInfo, &buffer, &allocation,
+											&allocationInfo));
+
+			*mapped = allocationInfo.pMappedData;
+		}
+
+		void StagingRing::reclaim()
+		{
+			while (!regions.empty() && regions.front().released && regions.front().point.reached())
+				regions.pop_front();
+
+			if (regions.empty())
+				head = 0;
+
+			std::erase_if(dedicatedBuffers, [&](DedicatedBuffer& dedicated) {
+				if (!dedicated.released || !dedicated.point.reached())
+					return false;
+				vmaDestroyBuffer(vktDevice->vmaAllocator, dedicated.buffer, dedicated.allocation);
+				return true;
+			});
+		}
+
+		StagingRing::Allocation StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment)
+		{
+			if (!buffer)
+				createBuffer(capacity, buffer, allocation, (void**)&mapped);
+
+			reclaim();
+
+			alignment = std::max(alignment,
+								 vktDevice->physicalDevice->deviceProperties.limits.optimalBufferCopyOffsetAlignment);
+
+			if (size <= capacity)
+			{
+				VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+				if (offset + size > capacity)
+					offset = 0; // wrap around, the end of the ring is skipped
+
+				auto inTheWay = [&]() {
+					return std::any_of(regions.begin(), regions.end(), [&](const Region& region) {
+						return region.begin < offset + size && offset < region.end;
+					});
+				};
+
+				// the oldest regions are the ones in the way, unless the ring is full of data not released yet
+				while (inTheWay() && regions.front().released)
+				{
+					regions.front().point.wait();
+					regions.pop_front();
+				}
+
+				if (!inTheWay())
+				{
+					regions.push_back({ offset, offset + size, {}, false });
+					head = offset + size;
+
+					return { buffer, offset, mapped + offset };
+				}
+			}
+
+			DedicatedBuffer dedicated{ VK_NULL_HANDLE, nullptr, {}, false };
+			void* dedicatedMapped;
+			createBuffer(size, dedicated.buffer, dedicated.allocation, &dedicatedMapped);
+			dedicatedBuffers.push_back(dedicated);
+
+			return { dedicated.buffer, 0, dedicatedMapped };
+		}
+
+		StagingRing::Allocation StagingRing::upload(const void* data, VkDeviceSize size, VkDeviceSize alignment)
+		{
+			Allocation staging = allocate(size, alignment);
+			memcpy(staging.mapped, data, size);
+			return staging;
+		}
+
+		void StagingRing::release(TimelinePoint point)
+		{
+			for (Region& region : regions)
+				if (!region.released)
+					region = { region.begin, region.end, point, true };
+
+			for (DedicatedBuffer& dedicated : dedicatedBuffers)
+				if (!dedicated.released)
+				{
+					dedicated.point = point;
+					dedicated.released = true;
+				}
+		}
+
+		void StagingRing::destroy()
+		{
+			for (Region& region : regions)
+				region.point.wait();
+			for (DedicatedBuffer& dedicated : dedicatedBuffers)
+			{
+				dedicated.point.wait();
+				vmaDestroyBuffer(vktDevice->vmaAllocator, dedicated.buffer, dedicated.allocation);
+			}
+
+			if (buffer)
+				vmaDestroyBuffer(vktDevice->vmaAllocator, buffer, allocation);
+
+			delete (this);
+		}
 	} // namespace Buffers
 } // namespace vkt
\ No newline at end of file
@@ -9,6 +9,10 @@
 #pragma once
 
 #include "vktdevices.h"
+#include "vkttimeline.h"
+
+// staging memory of each device handle, bigger uploads go to dedicated buffers
+#define STAGING_RING_SIZE (8 * 1024 * 1024)
 
 namespace vkt
 {
@@ -26,14 +30,17 @@ namespace vkt
 
 			VkBuffer buffer = VK_NULL_HANDLE;
 			VmaAllocation allocation = nullptr;
+			VmaAllocationInfo allocationInfo{};
 
 		  public:
 			AllocatedBuffer(Logical::Device* vktDevice, bool pushToDeletionQueue = true);
 
 			/**
 			Does automatic padding alignment
+			@param allocationFlags e.g. VMA_ALLOCATION_CREATE_MAPPED_BIT to keep it persistently mapped
 			*/
-			AllocatedBuffer* allocate(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+			AllocatedBuffer* allocate(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+									  VmaAllocationCreateFlags allocationFlags = 0);
 
 			AllocatedBuffer* map(void** data)
 			{
@@ -46,6 +53,9 @@ namespace vkt
 				return this;
 			}
 
+			/**
+			Copies data at the start of the buffer, through the persistent mapping if there is one
+			*/
 			AllocatedBuffer* putData(void* data, size_t size);
 
 			void destroy();
@@ -58,6 +68,141 @@ namespace vkt
 			{
 				return allocation;
 			}
+			/**
+			nullptr if not allocated with VMA_ALLOCATION_CREATE_MAPPED_BIT
+			*/
+			void* getMappedData()
+			{
+				return allocationInfo.pMappedData;
+			}
+		};
+
+		/**
+		Wraps host memory that we don't own (e.g. a video frame) in a VkBuffer through VK_EXT_external_memory_host,
+		so the gpu can copy from/to it directly.
+		The pages containing the range are imported, use getOffset() as the buffer offset of the range.
+		*/
+		class ImportedHostBuffer
+		{
+		  public:
+			ImportedHostBuffer(Logical::Device* vktDevice, bool pushToDeletionQueue = true);
+
+			/**
+			Returns true if the device has VK_EXT_external_memory_host enabled.
+			*/
+			static bool isSupported(Logical::Device* vktDevice);
+
+			/**
+			Releases the previous import, then imports the pages containing [hostPointer, hostPointer + size).
+			The host memory must stay valid until release() is called and the gpu is done with it.
+			@return false if the import failed (fall back to a staging copy)
+			*/
+			bool import(void* hostPointer, size_t size, VkBufferUsageFlags usage);
+
+			/**
+			Frees the imported memory and the buffer, the host memory is untouched.
+			*/
+			void release();
+
+			void destroy();
+
+			bool isImported(const void* hostPointer, size_t size)
+			{
+				return buffer && this->hostPointer == hostPointer && this->size == size;
+			}
+
+			VkBuffer getBuffer()
+			{
+				return buffer;
+			}
+			VkDeviceSize getOffset()
+			{
+				return offset;
+			}
+
+		  private:
+			Logical::Device* vktDevice;
+
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+
+			const void* hostPointer = nullptr;
+			size_t size = 0;
+			VkDeviceSize offset = 0;
+		};
+
+		/**
+		Persistently mapped (host coherent) staging buffer for the uploads, suballocated linearly and reused as a ring.
+		Every allocation is tracked by the timeline point of the submission that reads it, and its space is reclaimed
+		once the gpu has reached it, so uploads don't create and destroy buffers in steady state.
+		Not thread safe, one per device handle.
+		*/
+		class StagingRing
+		{
+		  public:
+			StagingRing(Logical::Device* vktDevice, VkDeviceSize capacity, bool pushToDeletionQueue = true);
+
+			struct Allocation
+			{
+				VkBuffer buffer = VK_NULL_HANDLE;
+				VkDeviceSize offset = 0;
+				void* mapped = nullptr;
+			};
+
+			/**
+			Suballocates size bytes at an offset aligned for copy commands (at least alignment), wrapping around to the
+			start of the ring and waiting for the oldest released allocations if they are in the way.
+			What doesn't fit next to the data not released yet goes to a dedicated buffer, freed the same way.
+			The buffer is created by the first call.
+			*/
+			Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+			/**
+			Allocates and copies data
+			*/
+			Allocation upload(const void* data, VkDeviceSize size, VkDeviceSize alignment = 16);
+
+			/**
+			The allocations made since the last release are read by the submission that completes at point
+			*/
+			void release(TimelinePoint point);
+
+			/**
+			Waits for the released allocations, then frees everything
+			*/
+			void destroy();
+
+		  private:
+			struct Region
+			{
+				VkDeviceSize begin, end;
+				TimelinePoint point;
+				bool released;
+			};
+
+			struct DedicatedBuffer
+			{
+				VkBuffer buffer;
+				VmaAllocation allocation;
+				TimelinePoint point;
+				bool released;
+			};
+
+			void createBuffer(VkDeviceSize size, VkBuffer& buffer, VmaAllocation& allocation, void** mapped);
+			void reclaim();
+
+			Logical::Device* vktDevice;
+
+			VkDeviceSize capacity;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VmaAllocation allocation = nullptr;
+			uint8_t* mapped = nullptr;
+
+			// next free byte, regions in allocation order (the oldest is the next one in the way)
+			VkDeviceSize head = 0;
+			std::deque<Region> regions;
+
+			std::vector<DedicatedBuffer> dedicatedBuffers;
 		};
 	}; // namespace Buffers
 
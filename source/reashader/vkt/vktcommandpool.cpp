@@ -169,40 +169,18 @@ namespace vkt
 	}
 
 	/**
-	Ends the commandBuffer, then submits it (top of pipe).
+	Ends the commandBuffer, then submits it to the queue batch (waiting at waitStage for waitSemaphore, and for the
+	timeline waits). Always signals the next value of the queue timeline.
 	*/
-	void CommandPool::submitQueueSingle(VkCommandBuffer commandBuffer, VkFence fence, VkSemaphore signalSemaphore,
-										VkSemaphore waitSemaphore)
+	TimelinePoint CommandPool::submitQueueSingle(VkCommandBuffer commandBuffer, VkFence fence,
+												 VkSemaphore signalSemaphore, VkSemaphore waitSemaphore,
+												 VkPipelineStageFlags waitStage,
+												 std::initializer_list<TimelineWait> timelineWaits)
 	{
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-		std::array<VkSemaphore, 1> waitSemaphores = { waitSemaphore };
-		std::array<VkPipelineStageFlags, 1> waitStages = { VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT };
-		if (waitSemaphore)
-		{
-			submitInfo.waitSemaphoreCount = 1;
-			submitInfo.pWaitSemaphores = waitSemaphores.data();
-			submitInfo.pWaitDstStageMask = waitStages.data();
-		}
-
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-
-		std::array<VkSemaphore, 1> signalSemaphores = { signalSemaphore };
-		if (signalSemaphore)
-		{
-			submitInfo.signalSemaphoreCount = 1;
-			submitInfo.pSignalSemaphores = signalSemaphores.data();
-		}
-
-		if (vkQueueSubmit(vktQueue->vk(), 1, &submitInfo, fence) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to submit draw command buffer!");
-		}
+		return vktQueue->submit(commandBuffer, fence, signalSemaphore, waitSemaphore, waitStage, timelineWaits);
 	}
 
 	/**
@@ -210,11 +188,11 @@ namespace vkt
 	@param id
 	*/
 	CommandPool* CommandPool::submit(const int id, VkFence fence, VkSemaphore signalSemaphore,
-									 VkSemaphore waitSemaphore)
+									 VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage)
 	{
 
 		VkCommandBuffer cmd = get(id);
-		submitQueueSingle(cmd, fence, signalSemaphore, waitSemaphore);
+		submitQueueSingle(cmd, fence, signalSemaphore, waitSemaphore, waitStage, {});
 
 		return this;
 	}
@@ -222,12 +200,19 @@ namespace vkt
 	Submits the command buffer provided.
 	*/
 	CommandPool* CommandPool::submit(VkCommandBuffer cmd, VkFence fence, VkSemaphore signalSemaphore,
-									 VkSemaphore waitSemaphore)
+									 VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage)
 	{
 
-		submitQueueSingle(cmd, fence, signalSemaphore, waitSemaphore);
+		submitQueueSingle(cmd, fence, signalSemaphore, waitSemaphore, waitStage, {});
 
 		return this;
 	}
+	/**
+	Submits the command buffer provided after the timeline waits.
+	*/
+	TimelinePoint CommandPool::submit(VkCommandBuffer cmd, std::initializer_list<TimelineWait> waits)
+	{
+		return submitQueueSingle(cmd, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, 0, waits);
+	}
 
 } // namespace vkt
\ No newline at end of file
@@ -72,22 +72,38 @@ namespace vkt
 
 	  private:
 		/**
-		Ends the commandBuffer, then submits it (top of pipe).
+		Ends the commandBuffer, then submits it to the queue batch (waiting at waitStage for waitSemaphore, and for the
+		timeline waits). Always signals the next value of the queue timeline.
 		*/
-		void submitQueueSingle(VkCommandBuffer commandBuffer, VkFence fence, VkSemaphore signalSemaphore,
-							   VkSemaphore waitSemaphore);
+		TimelinePoint submitQueueSingle(VkCommandBuffer commandBuffer, VkFence fence, VkSemaphore signalSemaphore,
+										VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage,
+										std::initializer_list<TimelineWait> timelineWaits);
 
 	  public:
 		/**
 		Submits the command buffer specified by id.
 		@param id
 		*/
-		CommandPool* submit(const int id, VkFence fence, VkSemaphore signalSemaphore, VkSemaphore waitSemaphore);
+		CommandPool* submit(const int id, VkFence fence, VkSemaphore signalSemaphore, VkSemaphore waitSemaphore,
+							VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
 
 		/**
 		Submits the command buffer provided.
+		@param waitStage the stage that waits for waitSemaphore
 		*/
-		CommandPool* submit(VkCommandBuffer cmd, VkFence fence, VkSemaphore signalSemaphore, VkSemaphore waitSemaphore);
+		CommandPool* submit(VkCommandBuffer cmd, VkFence fence, VkSemaphore signalSemaphore, VkSemaphore waitSemaphore,
+							VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+		/**
+		Submits the command buffer provided after the timeline waits.
+		@return the point of the queue timeline signaled when the command buffer has completed
+		*/
+		TimelinePoint submit(VkCommandBuffer cmd, std::initializer_list<TimelineWait> waits = {});
+
+		Queue* getQueue()
+		{
+			return vktQueue;
+		}
 
 	  private:
 		VkCommandPool m_commandPool = VK_NULL_HANDLE;
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "vktbuffers.h"
+#include "vktcommandpool.h"
 
 namespace vkt
 {
@@ -18,16 +19,22 @@ namespace vkt
 	namespace commands
 	{
 
+		/**
+		 * Pass the queue families for a queue family ownership transfer, the same barrier has to be recorded on both
+		 * queues (release on the source one, acquire on the destination one).
+		 */
 		static void insertImageMemoryBarrier(VkCommandBuffer cmdbuffer, VkImage image, VkAccessFlags srcAccessMask,
 											 VkAccessFlags dstAccessMask, VkImageLayout oldImageLayout,
 											 VkImageLayout newImageLayout, VkPipelineStageFlags srcStageMask,
 											 VkPipelineStageFlags dstStageMask,
-											 VkImageSubresourceRange subresourceRange)
+											 VkImageSubresourceRange subresourceRange,
+											 uint32_t srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+											 uint32_t dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED)
 		{
 			VkImageMemoryBarrier imageMemoryBarrier{};
 			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageMemoryBarrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+			imageMemoryBarrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
 			imageMemoryBarrier.srcAccessMask = srcAccessMask;
 			imageMemoryBarrier.dstAccessMask = dstAccessMask;
 			imageMemoryBarrier.oldLayout = oldImageLayout;
@@ -39,42 +46,39 @@ namespace vkt
 								 &imageMemoryBarrier);
 		}
 
-		/**
-		Allocates a buffer with pixelSrc contents for transfer src usage.
-		*/
-		static Buffers::AllocatedBuffer* createPixelBufferSrc(Logical::Device* vktDevice, char* pixelsSrc,
-															  VkExtent2D extent)
+		static void insertBufferMemoryBarrier(VkCommandBuffer cmdbuffer, VkBuffer buffer, VkAccessFlags srcAccessMask,
+											  VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask,
+											  VkPipelineStageFlags dstStageMask, VkDeviceSize offset = 0,
+											  VkDeviceSize size = VK_WHOLE_SIZE)
 		{
-			// create staging buffer
-			int buffSize = extent.width * extent.height * 4;
-			Buffers::AllocatedBuffer* srcBuff = new Buffers::AllocatedBuffer(vktDevice, false);
-			srcBuff->allocate(buffSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
-
-			// copy pixels to staging buffer
-
-			void* data;
-			VK_CHECK_RESULT(vmaMapMemory(vktDevice->vmaAllocator, srcBuff->getAllocation(), &data))
+			VkBufferMemoryBarrier bufferMemoryBarrier{};
+			bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferMemoryBarrier.srcAccessMask = srcAccessMask;
+			bufferMemoryBarrier.dstAccessMask = dstAccessMask;
+			bufferMemoryBarrier.buffer = buffer;
+			bufferMemoryBarrier.offset = offset;
+			bufferMemoryBarrier.size = size;
 
-			memcpy(data, pixelsSrc, buffSize);
-
-			vmaUnmapMemory(vktDevice->vmaAllocator, srcBuff->getAllocation());
-
-			return srcBuff;
+			vkCmdPipelineBarrier(cmdbuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0,
+								 nullptr);
 		}
 
 		/**
-		 * Transfer allocated pixel buffer (usage transfer src) to image.
+		 * Transfer a tightly packed pixel region of a buffer (usage transfer src), starting at bufferOffset, to image.
 		 *
 		 * \param cmd
-		 * \param srcBuff
+		 * \param srcBuffer
+		 * \param bufferOffset
 		 * \param imageDst
 		 * \param extent
 		 * \param finalAccessMask
 		 * \param finalImageLayout
 		 * \param finalStageMask
 		 */
-		static void transferPixelBufferToImage(VkCommandBuffer cmd, Buffers::AllocatedBuffer* srcBuff, VkImage imageDst,
-											   VkExtent2D extent, VkAccessFlags finalAccessMask,
+		static void transferPixelBufferToImage(VkCommandBuffer cmd, VkBuffer srcBuffer, VkDeviceSize bufferOffset,
+											   VkImage imageDst, VkExtent2D extent, VkAccessFlags finalAccessMask,
 											   VkImageLayout finalImageLayout, VkPipelineStageFlags finalStageMask)
 		{
 
@@ -88,7 +92,7 @@ namespace vkt
 			// copy buffer to image
 
 			VkBufferImageCopy copyRegion = {};
-			copyRegion.bufferOffset = 0;
+			copyRegion.bufferOffset = bufferOffset;
 			copyRegion.bufferRowLength = 0;
 			copyRegion.bufferImageHeight = 0;
 
@@ -98,7 +102,7 @@ namespace vkt
 			copyRegion.imageSubresource.layerCount = 1;
 			copyRegion.imageExtent = { extent.width, extent.height, 1 };
 
-			vkCmdCopyBufferToImage(cmd, srcBuff->getBuffer(), imageDst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+			vkCmdCopyBufferToImage(cmd, srcBuffer, imageDst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
 								   &copyRegion);
 
 			// retransition
@@ -108,6 +112,172 @@ namespace vkt
 											   VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
 		}
 
+		/**
+		 * Copy a tightly packed region of a buffer, starting at bufferOffset, to the whole image (color aspect).
+		 * Image must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
+		 */
+		static void copyBufferToImage(VkCommandBuffer cmd, VkBuffer srcBuffer, VkDeviceSize bufferOffset,
+									  VkImage imageDst, VkExtent2D extent)
+		{
+			VkBufferImageCopy copyRegion = {};
+			copyRegion.bufferOffset = bufferOffset;
+			copyRegion.bufferRowLength = 0;
+			copyRegion.bufferImageHeight = 0;
+
+			copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copyRegion.imageSubresource.mipLevel = 0;
+			copyRegion.imageSubresource.baseArrayLayer = 0;
+			copyRegion.imageSubresource.layerCount = 1;
+			copyRegion.imageExtent = { extent.width, extent.height, 1 };
+
+			vkCmdCopyBufferToImage(cmd, srcBuffer, imageDst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+		}
+
+		/**
+		 * Blit the whole image (color aspect), converting the format (e.g. between rgba and bgra) and scaling.
+		 * Images must be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL and VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
+		 */
+		static void blitImage(VkCommandBuffer cmd, VkImage imageSrc, VkExtent2D srcExtent, VkImage imageDst,
+							  VkExtent2D dstExtent, VkFilter filter = VK_FILTER_LINEAR)
+		{
+			VkImageBlit blitRegion{};
+			blitRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			blitRegion.srcOffsets[1] = { (int32_t)srcExtent.width, (int32_t)srcExtent.height, 1 };
+			blitRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			blitRegion.dstOffsets[1] = { (int32_t)dstExtent.width, (int32_t)dstExtent.height, 1 };
+
+			vkCmdBlitImage(cmd, imageSrc, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, imageDst,
+						   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitRegion, filter);
+		}
+
+		/**
+		 * Copy the whole image (color aspect) to another one of the same extent, or scale it with filter if the
+		 * extents differ (the format must support blits, and linear filtering for VK_FILTER_LINEAR).
+		 * Source must be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destination in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
+		 */
+		static void copyOrBlitImage(VkCommandBuffer cmd, VkImage imageSrc, VkExtent2D srcExtent, VkImage imageDst,
+									VkExtent2D dstExtent, VkFilter filter = VK_FILTER_LINEAR)
+		{
+			if (srcExtent.width == dstExtent.width && srcExtent.height == dstExtent.height)
+			{
+				VkImageCopy copyRegion{};
+				copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				copyRegion.extent = { srcExtent.width, srcExtent.height, 1 };
+
+				vkCmdCopyImage(cmd, imageSrc, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, imageDst,
+							   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+				return;
+			}
+
+			blitImage(cmd, imageSrc, srcExtent, imageDst, dstExtent, filter);
+		}
+
+		/**
+		 * Copy the whole image (color aspect) to a region of a buffer, starting at bufferOffset.
+		 * Rows are bufferRowLength texels apart (0 for tightly packed).
+		 * Image must be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL.
+		 */
+		static void copyImageToBuffer(VkCommandBuffer cmd, VkImage imageSrc, VkBuffer dstBuffer,
+									  VkDeviceSize bufferOffset, VkExtent2D extent, uint32_t bufferRowLength = 0)
+		{
+			VkBufferImageCopy copyRegion = {};
+			copyRegion.bufferOffset = bufferOffset;
+			copyRegion.bufferRowLength = bufferRowLength;
+			copyRegion.bufferImageHeight = 0;
+
+			copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copyRegion.imageSubresource.mipLevel = 0;
+			copyRegion.imageSubresource.baseArrayLayer = 0;
+			copyRegion.imageSubresource.layerCount = 1;
+			copyRegion.imageExtent = { extent.width, extent.height, 1 };
+
+			vkCmdCopyImageToBuffer(cmd, imageSrc, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstBuffer, 1, &copyRegion);
+		}
+
+		/**
+		 * Copy rects of a buffer holding a whole frame, starting at bufferOffset, to the same rects of the image (color
+		 * aspect). Rows are bufferRowLength texels apart.
+		 * Image must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
+		 */
+		static void copyBufferRectsToImage(VkCommandBuffer cmd, VkBuffer srcBuffer, VkDeviceSize bufferOffset,
+										   uint32_t bufferRowLength, uint32_t texelSize, VkImage imageDst,
+										   const std::vector<VkRect2D>& rects)
+		{
+			if (rects.empty())
+				return;
+
+			std::vector<VkBufferImageCopy> copyRegions(rects.size());
+
+			for (size_t i = 0; i < rects.size(); i++)
+			{
+				const VkRect2D& rect = rects[i];
+				VkBufferImageCopy& copyRegion = copyRegions[i];
+
+				copyRegion.bufferOffset =
+					bufferOffset + ((VkDeviceSize)rect.offset.y * bufferRowLength + rect.offset.x) * texelSize;
+				copyRegion.bufferRowLength = bufferRowLength;
+				copyRegion.bufferImageHeight = 0;
+
+				copyRegion.imageSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				copyRegion.imageOffset = { rect.offset.x, rect.offset.y, 0 };
+				copyRegion.imageExtent = { rect.extent.width, rect.extent.height, 1 };
+			}
+
+			vkCmdCopyBufferToImage(cmd, srcBuffer, imageDst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+								   static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+		}
+
+		/**
+		 * Host side write of rects of a frame to the same rects of the image (VK_EXT_host_image_copy, no command
+		 * buffer). Rows are memoryRowLength texels apart.
+		 * The image must have been created with VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT and not be in use by the gpu,
+		 * it's left in VK_IMAGE_LAYOUT_GENERAL. Pass VK_IMAGE_LAYOUT_UNDEFINED as oldLayout only if the previous
+		 * contents can be discarded (every rect is written).
+		 */
+		static void hostCopyMemoryToImage(Logical::Device* vktDevice, const void* srcBuffer, uint32_t memoryRowLength,
+										  uint32_t texelSize, VkImage imageDst, VkImageLayout oldLayout,
+										  const std::vector<VkRect2D>& rects)
+		{
+			VkHostImageLayoutTransitionInfoEXT transitionInfo{};
+			transitionInfo.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT;
+			transitionInfo.image = imageDst;
+			transitionInfo.oldLayout = oldLayout;
+			transitionInfo.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			transitionInfo.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+			VK_CHECK_RESULT(vktDevice->ext.transitionImageLayout(vktDevice->vk(), 1, &transitionInfo));
+
+			if (rects.empty())
+				return;
+
+			std::vector<VkMemoryToImageCopyEXT> regions(rects.size());
+
+			for (size_t i = 0; i < rects.size(); i++)
+			{
+				const VkRect2D& rect = rects[i];
+				VkMemoryToImageCopyEXT& region = regions[i];
+
+				region.sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT;
+				region.pHostPointer = (const uint8_t*)srcBuffer +
+									  ((size_t)rect.offset.y * memoryRowLength + rect.offset.x) * texelSize;
+				region.memoryRowLength = memoryRowLength;
+				region.memoryImageHeight = 0;
+				region.imageSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				region.imageOffset = { rect.offset.x, rect.offset.y, 0 };
+				region.imageExtent = { rect.extent.width, rect.extent.height, 1 };
+			}
+
+			VkCopyMemoryToImageInfoEXT copyInfo{};
+			copyInfo.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT;
+			copyInfo.dstImage = imageDst;
+			copyInfo.dstImageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			copyInfo.regionCount = static_cast<uint32_t>(regions.size());
+			copyInfo.pRegions = regions.data();
+
+			VK_CHECK_RESULT(vktDevice->ext.copyMemoryToImage(vktDevice->vk(), &copyInfo));
+		}
+
 		/**
 		 * Transfer raw buffer to allocated image (currently the image must be mapped).
 		 */
@@ -131,5 +301,25 @@ namespace vkt
 						   subResourceLayout.offset),
 				   (void*)srcBuffer, size);
 		}
+
+		/**
+		 * Copies data to a device local buffer (usage transfer dst) through the staging ring of the device, on the
+		 * graphics queue, and waits for it.
+		 */
+		static void uploadToBuffer(Logical::Device* vktDevice, VkBuffer dstBuffer, const void* data, VkDeviceSize size)
+		{
+			Buffers::StagingRing::Allocation staging = vktDevice->getStagingRing()->upload(data, size);
+
+			VkCommandBuffer cmd = vktDevice->getGraphicsCommandPool()->createCommandBuffer();
+
+			VkBufferCopy copyRegion{ staging.offset, 0, size };
+			vkCmdCopyBuffer(cmd, staging.buffer, dstBuffer, 1, &copyRegion);
+
+			TimelinePoint copied = vktDevice->getGraphicsCommandPool()->submit(cmd);
+			vktDevice->getStagingRing()->release(copied);
+			copied.wait();
+
+			vkFreeCommandBuffers(vktDevice->vk(), vktDevice->getGraphicsCommandPool()->vk(), 1, &cmd);
+		}
 	}; // namespace commands
 } // namespace vkt
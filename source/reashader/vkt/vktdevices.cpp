@@ -7,6 +7,7 @@
  *****************************************************************************/
 
 #include "vktdevices.h"
+#include "vktbuffers.h"
 #include "vktcommandpool.h"
 #include "vktqueue.h"
 
@@ -166,6 +167,23 @@ namespace vkt
 				}
 			}
 
+			// Import alignment for external host memory
+			if (extensionSupported(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) &&
+				deviceProperties.apiVersion >= VK_API_VERSION_1_1)
+			{
+				VkPhysicalDeviceExternalMemoryHostPropertiesEXT externalMemoryHostProperties{};
+				externalMemoryHostProperties.sType =
+					VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+
+				VkPhysicalDeviceProperties2 deviceProperties2{};
+				deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+				deviceProperties2.pNext = &externalMemoryHostProperties;
+
+				vkGetPhysicalDeviceProperties2(vkPhysicalDevice, &deviceProperties2);
+
+				minImportedHostPointerAlignment = externalMemoryHostProperties.minImportedHostPointerAlignment;
+			}
+
 			deletionQueue.push_function([=]() { delete (this); });
 		}
 
@@ -225,6 +243,40 @@ namespace vkt
 
 			return supportsBlit.value();
 		}
+
+		bool Device::supportsHostImageCopy(VkFormat format)
+		{
+			if (!extensionSupported(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME) ||
+				deviceProperties.apiVersion < VK_API_VERSION_1_3)
+				return false;
+
+			// feature
+
+			VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures{};
+			hostImageCopyFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+
+			VkPhysicalDeviceFeatures2 features2{};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features2.pNext = &hostImageCopyFeatures;
+
+			vkGetPhysicalDeviceFeatures2(vkPhysicalDevice, &features2);
+
+			if (!hostImageCopyFeatures.hostImageCopy)
+				return false;
+
+			// format
+
+			VkFormatProperties3 formatProperties3{};
+			formatProperties3.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3;
+
+			VkFormatProperties2 formatProperties2{};
+			formatProperties2.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2;
+			formatProperties2.pNext = &formatProperties3;
+
+			vkGetPhysicalDeviceFormatProperties2(vkPhysicalDevice, format, &formatProperties2);
+
+			return formatProperties3.optimalTilingFeatures & VK_FORMAT_FEATURE_2_HOST_IMAGE_TRANSFER_BIT_EXT;
+		}
 	} // namespace Physical
 
 	namespace Logical
@@ -232,7 +284,7 @@ namespace vkt
 		Device::Device(deletion_queue& deletionQueue, Physical::Device* physicalDevice,
 					   VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char*> enabledExtensions,
 					   bool useSwapChain)
-			: physicalDevice(physicalDevice), pDeletionQueue(&deletionQueue)
+			: physicalDevice(physicalDevice), pDeletionQueue(&deletionQueue), enabledFeatures(enabledFeatures)
 		{
 
 			deletionQueue.push_function([=]() { delete (this); });
@@ -242,17 +294,53 @@ namespace vkt
 			shader_draw_parameters_features.pNext = NULL;
 			shader_draw_parameters_features.shaderDrawParameters = VK_TRUE;
 
-			createLogicalDevice(&shader_draw_parameters_features, enabledFeatures, enabledExtensions, useSwapChain);
+			// every submission signals the timeline of its queue
+			VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore_features = {};
+			timeline_semaphore_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+			timeline_semaphore_features.pNext = &shader_draw_parameters_features;
+			timeline_semaphore_features.timelineSemaphore = VK_TRUE;
+
+			createLogicalDevice(&timeline_semaphore_features, enabledFeatures, enabledExtensions, useSwapChain);
 
 			graphicsQueue =
 				new Queue(deletionQueue, vkDevice, physicalDevice->queueFamilyIndices.graphicsFamily.value());
-			transferQueue =
-				new Queue(deletionQueue, vkDevice, physicalDevice->queueFamilyIndices.transferFamily.value());
+			// without a dedicated family the transfers go to the same VkQueue, through the same (synchronized) batch
+			transferQueue = physicalDevice->queueFamilyIndices.transferFamily.value() !=
+									physicalDevice->queueFamilyIndices.graphicsFamily.value()
+								? new Queue(deletionQueue, vkDevice,
+											physicalDevice->queueFamilyIndices.transferFamily.value())
+								: graphicsQueue;
 
 			graphicsCommandPool = new CommandPool(deletionQueue, graphicsQueue);
 			transferCommandPool = new CommandPool(deletionQueue, transferQueue);
 
 			createMemoryAllocator();
+
+			stagingRing = new Buffers::StagingRing(this, STAGING_RING_SIZE);
+
+			loadExtensionFunctions();
+
+			VkPipelineCacheCreateInfo pipelineCacheInfo{};
+			pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+			VK_CHECK_RESULT(vkCreatePipelineCache(vkDevice, &pipelineCacheInfo, nullptr, &pipelineCache));
+
+			deletionQueue.push_function([=]() { vkDestroyPipelineCache(vkDevice, pipelineCache, nullptr); });
+		}
+
+		Device::Device(deletion_queue& deletionQueue, Device* sharedDevice)
+			: vkDevice(sharedDevice->vkDevice), physicalDevice(sharedDevice->physicalDevice),
+			  pDeletionQueue(&deletionQueue), vmaAllocator(sharedDevice->vmaAllocator),
+			  pipelineCache(sharedDevice->pipelineCache), enabledFeatures(sharedDevice->enabledFeatures),
+			  ext(sharedDevice->ext), enabledDeviceExtensions(sharedDevice->enabledDeviceExtensions),
+			  graphicsQueue(sharedDevice->graphicsQueue), transferQueue(sharedDevice->transferQueue)
+		{
+			deletionQueue.push_function([=]() { delete (this); });
+
+			// command pools can't be used from multiple threads
+			graphicsCommandPool = new CommandPool(deletionQueue, graphicsQueue);
+			transferCommandPool = new CommandPool(deletionQueue, transferQueue);
+
+			stagingRing = new Buffers::StagingRing(this, STAGING_RING_SIZE);
 		}
 
 		void Device::createLogicalDevice(void* pNext, VkPhysicalDeviceFeatures enabledFeatures,
@@ -342,6 +430,10 @@ namespace vkt
 						std::cerr << "Enabled device extension \"" << enabledExtension
 								  << "\" is not present at device level\n";
 					}
+					else
+					{
+						enabledDeviceExtensions.push_back(enabledExtension);
+					}
 				}
 
 				createInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
@@ -358,6 +450,18 @@ namespace vkt
 				createInfo.enabledLayerCount = 0;
 			}
 
+			// extension features
+
+			VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures{};
+			hostImageCopyFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+			hostImageCopyFeatures.hostImageCopy = VK_TRUE;
+
+			if (extensionEnabled(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME))
+			{
+				hostImageCopyFeatures.pNext = pNext;
+				pNext = &hostImageCopyFeatures;
+			}
+
 			createInfo.pNext = pNext;
 
 			if (vkCreateDevice(physicalDevice->vk(), &createInfo, nullptr, &vkDevice) != VK_SUCCESS)
@@ -380,6 +484,37 @@ namespace vkt
 			pDeletionQueue->push_function([=]() { vmaDestroyAllocator(vmaAllocator); });
 		}
 
+		void Device::loadExtensionFunctions()
+		{
+			if (extensionEnabled(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME))
+			{
+				ext.getMemoryHostPointerProperties = (PFN_vkGetMemoryHostPointerPropertiesEXT)vkGetDeviceProcAddr(
+					vkDevice, "vkGetMemoryHostPointerPropertiesEXT");
+			}
+
+			if (extensionEnabled(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME))
+			{
+				ext.copyMemoryToImage =
+					(PFN_vkCopyMemoryToImageEXT)vkGetDeviceProcAddr(vkDevice, "vkCopyMemoryToImageEXT");
+				ext.transitionImageLayout =
+					(PFN_vkTransitionImageLayoutEXT)vkGetDeviceProcAddr(vkDevice, "vkTransitionImageLayoutEXT");
+			}
+
+			if (extensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+			{
+				ext.cmdDrawIndirectCount =
+					(PFN_vkCmdDrawIndirectCountKHR)vkGetDeviceProcAddr(vkDevice, "vkCmdDrawIndirectCountKHR");
+				ext.cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+					vkDevice, "vkCmdDrawIndexedIndirectCountKHR");
+			}
+		}
+
+		bool Device::extensionEnabled(std::string extension)
+		{
+			return (std::find(enabledDeviceExtensions.begin(), enabledDeviceExtensions.end(), extension) !=
+					enabledDeviceExtensions.end());
+		}
+
 		CommandPool* Device::getGraphicsCommandPool()
 		{
 			return graphicsCommandPool;
@@ -389,6 +524,11 @@ namespace vkt
 			return transferCommandPool;
 		}
 
+		Buffers::StagingRing* Device::getStagingRing()
+		{
+			return stagingRing;
+		}
+
 		Queue* Device::getGraphicsQueue()
 		{
 			return graphicsQueue;
@@ -14,6 +14,10 @@ namespace  vkt {
 
 	FWD_DECL(CommandPool);
 	FWD_DECL(Queue);
+	namespace Buffers
+	{
+		FWD_DECL(StagingRing);
+	}
 
 	namespace Physical
 	{
@@ -73,6 +77,10 @@ properties each time, they're already here upon construction.
 			/** @brief List of extensions supported by the device */
 			std::vector<std::string> supportedExtensions;
 
+			/** @brief Alignment required for host pointers imported with VK_EXT_external_memory_host, 0 if the
+			 * extension is not available */
+			VkDeviceSize minImportedHostPointerAlignment = 0;
+
 			// -----
 
 			VkPhysicalDevice vk()
@@ -109,6 +117,12 @@ properties each time, they're already here upon construction.
 			VkFormatProperties getFormatProperties(VkFormat format);
 
 			bool supportsBlit();
+
+			/**
+			 * Check if VK_EXT_host_image_copy can be used to write optimal tiled images of format from the host
+			 * (requires a Vulkan 1.3 device)
+			 */
+			bool supportsHostImageCopy(VkFormat format);
 		};
 
 	}
@@ -129,36 +143,84 @@ properties each time, they're already here upon construction.
 				   VkPhysicalDeviceFeatures enabledFeatures = {}, std::vector<const char*> enabledExtensions = {},
 				   bool useSwapChain = false);
 
+			/**
+			 * Another handle to sharedDevice for a different user: same VkDevice, queues, allocator and pipeline
+			 * cache, but its own command pools, and what is created through it goes to deletionQueue.
+			 * The shared device must outlive it.
+			 */
+			Device(deletion_queue& deletionQueue, Device* sharedDevice);
+
 			Physical::Device* physicalDevice;
 
 			deletion_queue* pDeletionQueue;
 
 			VmaAllocator vmaAllocator = VK_NULL_HANDLE;
 
+			// shared by the materials, so pipelines created by any user of the device are cached
+			VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+			/**
+			 * Core features enabled at device creation (requested, the caller checks they are supported)
+			 */
+			VkPhysicalDeviceFeatures enabledFeatures{};
+
 			VkDevice vk()
 			{
 				return vkDevice;
 			}
 
+			/**
+			 * Not while other users of the device are submitting (the queues must be externally synchronized), wait
+			 * for the queue timelines instead.
+			 */
 			void waitIdle()
 			{
+				graphicsQueue->flush();
+				transferQueue->flush();
 				VK_CHECK_RESULT(vkDeviceWaitIdle(vkDevice));
 			}
 
+			/**
+			 * Check if an extension has been enabled at device creation (requested and supported)
+			 */
+			bool extensionEnabled(std::string extension);
+
+			/**
+			 * Entry points of the enabled extensions, nullptr if the extension is not enabled
+			 */
+			struct ExtensionFunctions
+			{
+				PFN_vkGetMemoryHostPointerPropertiesEXT getMemoryHostPointerProperties = nullptr;
+				PFN_vkCopyMemoryToImageEXT copyMemoryToImage = nullptr;
+				PFN_vkTransitionImageLayoutEXT transitionImageLayout = nullptr;
+				PFN_vkCmdDrawIndirectCountKHR cmdDrawIndirectCount = nullptr;
+				PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+			} ext;
+
 			CommandPool* getGraphicsCommandPool();
 			CommandPool* getTransferCommandPool();
 			Queue* getGraphicsQueue();
 			Queue* getTransferQueue();
 
+			/**
+			 * Staging memory for the uploads through this handle, see Buffers::StagingRing
+			 */
+			Buffers::StagingRing* getStagingRing();
+
 		  private:
 			void createLogicalDevice(void* pNext, VkPhysicalDeviceFeatures enabledFeatures,
 									 std::vector<const char*> enabledExtensions, bool useSwapChain);
 
 			void createMemoryAllocator();
+			void loadExtensionFunctions();
+
+			std::vector<std::string> enabledDeviceExtensions;
 
 			CommandPool* graphicsCommandPool;
 			CommandPool* transferCommandPool;
 
+			Buffers::StagingRing* stagingRing;
+
 			Queue* graphicsQueue;
 			Queue* transferQueue;
 		};
@@ -0,0 +1,104 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#include "vktframecontext.h"
+
+namespace vkt
+{
+	FrameContext::FrameContext(deletion_queue& deletionQueue, VkDevice device) : device(device)
+	{
+		deletionQueue.push_function([=]() { destroy(); });
+	}
+
+	void FrameContext::reset()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (auto& [thread, pools] : threadPools)
+			for (TransientPool& pool : pools)
+			{
+				if (!pool.next)
+					continue;
+
+				VK_CHECK_RESULT(vkResetCommandPool(device, pool.vkCommandPool, 0));
+				pool.next = 0;
+			}
+	}
+
+	VkCommandBuffer FrameContext::createCommandBuffer(Queue* queue)
+	{
+		std::vector<TransientPool>* pools;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pools = &threadPools[std::this_thread::get_id()];
+		}
+
+		auto found = std::find_if(pools->begin(), pools->end(), [&](const TransientPool& pool) {
+			return pool.queueFamilyIndex == queue->getFamilyIndex();
+		});
+
+		if (found == pools->end())
+		{
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			poolInfo.queueFamilyIndex = queue->getFamilyIndex();
+
+			VkCommandPool vkCommandPool;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &poolInfo, nullptr, &vkCommandPool));
+
+			pools->push_back({ queue->getFamilyIndex(), vkCommandPool, {}, 0 });
+			found = pools->end() - 1;
+		}
+
+		TransientPool& pool = *found;
+
+		// reset with the pool, allocated only the first time the slot needs that many
+
+		if (pool.next == pool.commandBuffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = pool.vkCommandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer));
+			pool.commandBuffers.push_back(commandBuffer);
+		}
+
+		VkCommandBuffer commandBuffer = pool.commandBuffers[pool.next++];
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+		return commandBuffer;
+	}
+
+	TimelinePoint FrameContext::submit(Queue* queue, VkCommandBuffer commandBuffer,
+									   std::initializer_list<TimelineWait> waits)
+	{
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+		return queue->submit(commandBuffer, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, 0, waits);
+	}
+
+	void FrameContext::destroy()
+	{
+		// destroying the pools frees their command buffers
+		for (auto& [thread, pools] : threadPools)
+			for (TransientPool& pool : pools)
+				vkDestroyCommandPool(device, pool.vkCommandPool, nullptr);
+
+		delete (this);
+	}
+} // namespace vkt
@@ -0,0 +1,65 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#pragma once
+
+#include "vktcommon.h"
+#include "vktqueue.h"
+
+#include <mutex>
+#include <thread>
+
+namespace vkt
+{
+	/**
+	Command buffers of a frame slot. Every thread that records for the slot gets its own transient command pool per
+	queue family, command buffers are handed out linearly and the whole pools are reset when the slot is reused, instead
+	of resetting the command buffers one by one.
+	*/
+	class FrameContext
+	{
+	  public:
+		FrameContext(deletion_queue& deletionQueue, VkDevice device);
+
+		/**
+		Resets the pools of every thread, the command buffers handed out so far can be reused.
+		The submissions of the slot must be complete, and no thread recording.
+		*/
+		void reset();
+
+		/**
+		Next command buffer of the calling thread for queue, begun for one time submit.
+		*/
+		VkCommandBuffer createCommandBuffer(Queue* queue);
+
+		/**
+		Ends the command buffer, then submits it to queue after the timeline waits.
+		@return the point of the queue timeline signaled when the command buffer has completed
+		*/
+		TimelinePoint submit(Queue* queue, VkCommandBuffer commandBuffer,
+							 std::initializer_list<TimelineWait> waits = {});
+
+	  private:
+		struct TransientPool
+		{
+			uint32_t queueFamilyIndex;
+			VkCommandPool vkCommandPool;
+			// allocated so far, the ones before next are handed out
+			std::vector<VkCommandBuffer> commandBuffers;
+			size_t next;
+		};
+
+		void destroy();
+
+		VkDevice device = VK_NULL_HANDLE;
+
+		// only the lookup is locked, each thread records in its own pools
+		std::mutex mutex;
+		std::unordered_map<std::thread::id, std::vector<TransientPool>> threadPools;
+	};
+} // namespace vkt
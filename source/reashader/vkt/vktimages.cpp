@@ -32,7 +32,7 @@ namespace vkt
 		void AllocatedImage::createImage(VkExtent2D extent, VkImageType type, VkFormat format,
 										 VkImageTiling imageTiling, VkImageUsageFlags usageFlags,
 										 VmaMemoryUsage memoryUsage, VkMemoryPropertyFlags memoryProperties,
-										 VmaAllocationCreateFlags vmaFlags)
+										 VmaAllocationCreateFlags vmaFlags, uint32_t arrayLayers)
 		{
 
 			VkImageCreateInfo createInfo{};
@@ -43,8 +43,11 @@ namespace vkt
 
 			this->format = format;
 
+			this->arrayLayers = arrayLayers;
+			this->extent = extent;
+
 			createInfo.mipLevels = 1;
-			createInfo.arrayLayers = 1;
+			createInfo.arrayLayers = arrayLayers;
 
 			createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 			createInfo.tiling = imageTiling;
@@ -100,23 +103,20 @@ namespace vkt
 
 			VkCommandBuffer cmd = vktDevice->getGraphicsCommandPool()->createCommandBuffer();
 
-			Buffers::AllocatedBuffer* srcBuff = commands::createPixelBufferSrc(vktDevice, (char*)pixels, extent);
+			Buffers::StagingRing::Allocation staging =
+				vktDevice->getStagingRing()->upload(pixels, (VkDeviceSize)extent.width * extent.height * 4);
 
-			commands::transferPixelBufferToImage(cmd, srcBuff, image, extent, finalAccessMask, finalImageLayout,
-												 finalStageMask);
+			commands::transferPixelBufferToImage(cmd, staging.buffer, staging.offset, image, extent, finalAccessMask,
+												 finalImageLayout, finalStageMask);
 
 			// execute
 
-			VkFence fence = sync::createFence(vktDevice, false, false);
-
-			vktDevice->getGraphicsCommandPool()->submit(cmd, fence, VK_NULL_HANDLE, VK_NULL_HANDLE);
-
-			VK_CHECK_RESULT(vkWaitForFences(vktDevice->vk(), 1, &fence, VK_TRUE, UINT64_MAX));
+			TimelinePoint uploaded = vktDevice->getGraphicsCommandPool()->submit(cmd);
+			vktDevice->getStagingRing()->release(uploaded);
+			uploaded.wait();
 
 			// cleanup
 
-			srcBuff->destroy();
-			sync::destroySyncObject(vktDevice, fence);
 			vkFreeCommandBuffers(vktDevice->vk(), vktDevice->getGraphicsCommandPool()->vk(), 1, &cmd);
 
 			stbi_image_free(pixels);
@@ -135,7 +135,7 @@ namespace vkt
 			colorImageView.subresourceRange.baseMipLevel = 0;
 			colorImageView.subresourceRange.levelCount = 1;
 			colorImageView.subresourceRange.baseArrayLayer = 0;
-			colorImageView.subresourceRange.layerCount = 1;
+			colorImageView.subresourceRange.layerCount = arrayLayers;
 			colorImageView.image = image;
 			VK_CHECK_RESULT(vkCreateImageView(vktDevice->vk(), &colorImageView, nullptr, &imageView));
 		}
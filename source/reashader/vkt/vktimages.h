@@ -37,7 +37,8 @@ namespace  vkt {
 			*/
 			void createImage(VkExtent2D extent, VkImageType type, VkFormat format, VkImageTiling imageTiling,
 							 VkImageUsageFlags usageFlags, VmaMemoryUsage memoryUsage,
-							 VkMemoryPropertyFlags memoryProperties, VmaAllocationCreateFlags vmaFlags = NULL);
+							 VkMemoryPropertyFlags memoryProperties, VmaAllocationCreateFlags vmaFlags = NULL,
+							 uint32_t arrayLayers = 1);
 			/**
 			Create image from file
 			*/
@@ -57,6 +58,14 @@ namespace  vkt {
 			{
 				return format;
 			}
+			uint32_t getArrayLayers()
+			{
+				return arrayLayers;
+			}
+			VkExtent2D getExtent()
+			{
+				return extent;
+			}
 			VkImage getImage()
 			{
 				return image;
@@ -76,6 +85,8 @@ namespace  vkt {
 
 		  private:
 			VkFormat format = VK_FORMAT_UNDEFINED;
+			uint32_t arrayLayers = 1;
+			VkExtent2D extent{};
 			Logical::Device* vktDevice = nullptr;
 			bool pushToDeletionQueue;
 
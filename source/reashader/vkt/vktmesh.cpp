@@ -7,6 +7,7 @@
  *****************************************************************************/
 
 #include "vktrendering.h"
+#include "vktcommands.h"
 
 namespace vkt
 {
@@ -24,19 +25,43 @@ namespace vkt
 
 		Mesh* Mesh::setVertices(std::vector<Vertex> vertices)
 		{
-			vertexBuffer->allocate(vertices.size() * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-								   VMA_MEMORY_USAGE_GPU_TO_CPU);
-			vertexBuffer->putData(vertices.data(), vertices.size() * sizeof(Vertex));
+			// device local, uploaded through the staging ring
+			vertexBuffer->allocate(vertices.size() * sizeof(Vertex),
+								   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+								   VMA_MEMORY_USAGE_GPU_ONLY);
+			commands::uploadToBuffer(vktDevice, vertexBuffer->getBuffer(), vertices.data(),
+									 vertices.size() * sizeof(Vertex));
 
 			this->vertices = vertices;
 
+			// bounding sphere, centered in the bounds of the vertices
+
+			if (!vertices.empty())
+			{
+				glm::vec3 min = vertices[0].position, max = vertices[0].position;
+				for (const Vertex& vertex : vertices)
+				{
+					min = glm::min(min, vertex.position);
+					max = glm::max(max, vertex.position);
+				}
+
+				glm::vec3 center = (min + max) * 0.5f;
+				float radius = 0.f;
+				for (const Vertex& vertex : vertices)
+					radius = std::max(radius, glm::distance(center, vertex.position));
+
+				boundingSphere = glm::vec4(center, radius);
+			}
+
 			return this;
 		}
 		Mesh* Mesh::setIndices(std::vector<uint32_t> indices)
 		{
-			indexBuffer->allocate(indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-								  VMA_MEMORY_USAGE_GPU_TO_CPU);
-			indexBuffer->putData(indices.data(), indices.size() * sizeof(uint32_t));
+			indexBuffer->allocate(indices.size() * sizeof(uint32_t),
+								  VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+								  VMA_MEMORY_USAGE_GPU_ONLY);
+			commands::uploadToBuffer(vktDevice, indexBuffer->getBuffer(), indices.data(),
+									 indices.size() * sizeof(uint32_t));
 
 			this->indices = indices;
 
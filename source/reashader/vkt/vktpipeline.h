@@ -126,9 +126,8 @@ namespace vkt
 				//		pipeline cache
 				//////////////////////////
 
-				pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-				VK_CHECK_RESULT(vkCreatePipelineCache(vktDevice->vk(), &pipelineCacheCreateInfo, nullptr,
-													  &(material.pipelineCache)));
+				// the one of the device (shared by its users)
+				material.pipelineCache = vktDevice->pipelineCache;
 			}
 			~MaterialBuilder()
 			{
@@ -273,7 +272,6 @@ namespace vkt
 
 					vktDevice->pDeletionQueue->push_function([=]() {
 						vkDestroyPipeline(vktDevice->vk(), material.pipeline, nullptr);
-						vkDestroyPipelineCache(vktDevice->vk(), material.pipelineCache, nullptr);
 						vkDestroyPipelineLayout(vktDevice->vk(), material.pipelineLayout, nullptr);
 					});
 
@@ -315,12 +313,99 @@ namespace vkt
 
 			PipelineLayoutBuilder* pipelineLayoutbuilder;
 			PipelineBuilder* pipelineBuilder;
+		};
+
+		/**
+		Compute pipeline and its layout, dispatched in groups of the workgroup size (passed to the shader as the
+		specialization constants 0, 1 and 2, layout(local_size_x_id = 0, local_size_y_id = 1, local_size_z_id = 2) in)
+		*/
+		class ComputeMaterialBuilder : IBuilder<vkt::Rendering::Material>
+		{
+		  public:
+			ComputeMaterialBuilder(const ComputeMaterialBuilder&) = delete; // no copy, force passing references
+
+			ComputeMaterialBuilder(Logical::Device* vktDevice) : vktDevice(vktDevice)
+			{
+				// the one of the device (shared by its users)
+				material.pipelineCache = vktDevice->pipelineCache;
+
+				pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+				pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+			}
+
+			ComputeMaterialBuilder& setPushConstants(VkPushConstantRange& pushConstantRange)
+			{
+				pipelineLayoutInfo.pushConstantRangeCount = 1;
+				pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+				return *this;
+			}
+			ComputeMaterialBuilder& setDescriptors(std::vector<VkDescriptorSetLayout>& descriptorSetLayouts)
+			{
+				pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+				pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+				return *this;
+			}
+			ComputeMaterialBuilder& setShaderStage(VkPipelineShaderStageCreateInfo& shaderStage)
+			{
+				pipelineInfo.stage = shaderStage;
+				return *this;
+			}
+			ComputeMaterialBuilder& setWorkgroupSize(uint32_t x, uint32_t y = 1, uint32_t z = 1)
+			{
+				material.workgroupSize = { x, y, z };
+				return *this;
+			}
+
+			vkt::Rendering::Material build() override
+			{
+				VK_CHECK_RESULT(
+					vkCreatePipelineLayout(vktDevice->vk(), &pipelineLayoutInfo, nullptr, &material.pipelineLayout));
+
+				// workgroup size
+
+				std::array<VkSpecializationMapEntry, 3> mapEntries{};
+				for (uint32_t i = 0; i < 3; i++)
+					mapEntries[i] = { i, i * static_cast<uint32_t>(sizeof(uint32_t)), sizeof(uint32_t) };
+
+				VkSpecializationInfo specializationInfo{};
+				specializationInfo.mapEntryCount = static_cast<uint32_t>(mapEntries.size());
+				specializationInfo.pMapEntries = mapEntries.data();
+				specializationInfo.dataSize = sizeof(material.workgroupSize);
+				specializationInfo.pData = material.workgroupSize.data();
+
+				pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+				pipelineInfo.layout = material.pipelineLayout;
+				pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+				pipelineInfo.basePipelineIndex = -1;
+
+				VK_CHECK_RESULT(vkCreateComputePipelines(vktDevice->vk(), material.pipelineCache, 1, &pipelineInfo,
+														 nullptr, &material.pipeline));
+
+				vkt::Logical::Device* device = vktDevice;
+				VkPipeline pipeline = material.pipeline;
+				VkPipelineLayout pipelineLayout = material.pipelineLayout;
+				vktDevice->pDeletionQueue->push_function([=]() {
+					vkDestroyPipeline(device->vk(), pipeline, nullptr);
+					vkDestroyPipelineLayout(device->vk(), pipelineLayout, nullptr);
+				});
+
+				return material;
+			}
+
+		  private:
+			Logical::Device* vktDevice;
+
+			vkt::Rendering::Material material{};
 
-			VkPipelineCacheCreateInfo pipelineCacheCreateInfo{};
+			VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+			VkComputePipelineCreateInfo pipelineInfo{};
 		};
 
+		/**
+		preamble is inserted before the source (after #version), e.g. the #defines of the device capabilities
+		*/
 		inline bool compile_glsl_to_spirv(std::string& glslSource, EShLanguage stage,
-										  std::vector<uint32_t>& spirvCodeOut)
+										  std::vector<uint32_t>& spirvCodeOut, const std::string& preamble = "")
 		{
 			glslang::InitializeProcess(); // Initialize glslang
 
@@ -328,6 +413,7 @@ namespace vkt
 			glslang::TShader shader(stage);
 			const char* shaderStrings[1] = { glslSource.data() };
 			shader.setStrings(shaderStrings, 1);
+			shader.setPreamble(preamble.c_str());
 
 			// Set up shader compilation options
 			int defaultVersion = 100;		 // overridden by #version in the shader
@@ -397,21 +483,22 @@ namespace vkt
 			return createShaderModule(vktDevice, reinterpret_cast<const uint32_t*>(code.data()), code.size());
 		}
 		inline VkShaderModule createShaderModule(Logical::Device* vktDevice, EShLanguage stage,
-												 std::vector<char>&& glslData)
+												 std::vector<char>&& glslData, const std::string& preamble = "")
 		{
 			// convert to string
 			glslData.push_back('\0');
 			std::string vertSource(std::move(glslData.data()));
 			// compile
 			std::vector<uint32_t> vertSpv;
-			compile_glsl_to_spirv(vertSource, stage, vertSpv);
+			compile_glsl_to_spirv(vertSource, stage, vertSpv, preamble);
 			// generate
 			return vkt::Pipeline::createShaderModule(vktDevice, vertSpv);
 		}
-		inline VkShaderModule createShaderModule(Logical::Device* vktDevice, EShLanguage stage, std::string glslPath)
+		inline VkShaderModule createShaderModule(Logical::Device* vktDevice, EShLanguage stage, std::string glslPath,
+												 const std::string& preamble = "")
 		{
 			std::vector<char> glslData = vkt::io::readFile(glslPath);
-			return vkt::Pipeline::createShaderModule(vktDevice, stage, std::move(glslData));
+			return vkt::Pipeline::createShaderModule(vktDevice, stage, std::move(glslData), preamble);
 		}
 
 	}; // namespace Pipeline
@@ -17,5 +17,109 @@ namespace vkt
 	{
 		deletionQueue.push_function([=]() { delete (this); });
 		vkGetDeviceQueue(device, queueFamilyIndex, 0, &vkQueue);
+		timeline = new Timeline(deletionQueue, device);
+		timeline->flushPending = [this]() { flush(); };
+	}
+
+	TimelinePoint Queue::submit(VkCommandBuffer commandBuffer, VkFence fence, VkSemaphore signalSemaphore,
+								VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage,
+								std::initializer_list<TimelineWait> timelineWaits)
+	{
+		// the values waited for have to reach the driver before this batch, if they are batched on another queue
+		// (before taking the lock, the other queue may be flushing while waiting for this one)
+
+		for (const TimelineWait& wait : timelineWaits)
+		{
+			if (wait.point.timeline && wait.point.timeline != timeline)
+				wait.point.timeline->ensureSubmitted(wait.point.value);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		Submission& submission = pending.emplace_back();
+		submission.commandBuffer = commandBuffer;
+
+		// binary semaphores take a value too, it's ignored
+
+		if (waitSemaphore)
+		{
+			submission.waitSemaphores.push_back(waitSemaphore);
+			submission.waitStages.push_back(waitStage);
+			submission.waitValues.push_back(0);
+		}
+
+		for (const TimelineWait& wait : timelineWaits)
+		{
+			if (!wait.point.timeline)
+				continue;
+
+			submission.waitSemaphores.push_back(wait.point.timeline->vk());
+			submission.waitStages.push_back(wait.stage);
+			submission.waitValues.push_back(wait.point.value);
+		}
+
+		TimelinePoint signaled{ timeline, timeline->reserve() };
+
+		submission.signalSemaphores.push_back(timeline->vk());
+		submission.signalValues.push_back(signaled.value);
+
+		if (signalSemaphore)
+		{
+			submission.signalSemaphores.push_back(signalSemaphore);
+			submission.signalValues.push_back(0);
+		}
+
+		if (fence || signalSemaphore || waitSemaphore)
+			flushLocked(fence);
+
+		return signaled;
+	}
+
+	void Queue::flush()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (!pending.empty())
+			flushLocked(VK_NULL_HANDLE);
+	}
+
+	void Queue::flushLocked(VkFence fence)
+	{
+		std::vector<VkSubmitInfo> submitInfos(pending.size());
+		std::vector<VkTimelineSemaphoreSubmitInfo> timelineInfos(pending.size());
+
+		for (size_t i = 0; i < pending.size(); i++)
+		{
+			Submission& submission = pending[i];
+
+			VkTimelineSemaphoreSubmitInfo& timelineInfo = timelineInfos[i];
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(submission.waitValues.size());
+			timelineInfo.pWaitSemaphoreValues = submission.waitValues.data();
+			timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(submission.signalValues.size());
+			timelineInfo.pSignalSemaphoreValues = submission.signalValues.data();
+
+			VkSubmitInfo& submitInfo = submitInfos[i];
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.pNext = &timelineInfo;
+			submitInfo.waitSemaphoreCount = static_cast<uint32_t>(submission.waitSemaphores.size());
+			submitInfo.pWaitSemaphores = submission.waitSemaphores.data();
+			submitInfo.pWaitDstStageMask = submission.waitStages.data();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &submission.commandBuffer;
+			submitInfo.signalSemaphoreCount = static_cast<uint32_t>(submission.signalSemaphores.size());
+			submitInfo.pSignalSemaphores = submission.signalSemaphores.data();
+		}
+
+		if (vkQueueSubmit(vkQueue, static_cast<uint32_t>(submitInfos.size()), submitInfos.data(), fence) !=
+			VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to submit draw command buffer!");
+		}
+
+		// the last reserved value, nothing else can be reserved while the lock is held
+		timeline->setSubmittedValue(timeline->getLastValue());
+
+		pending.clear();
 	}
 } // namespace vkt
\ No newline at end of file
@@ -9,9 +9,17 @@
 #pragma once
 
 #include "vktcommon.h"
+#include "vkttimeline.h"
+
+#include <mutex>
 
 namespace vkt
 {
+	/**
+	A device queue shared by every user of the device (thread safe).
+	Submissions are batched and given to the driver in a single vkQueueSubmit when something needs them: a cpu wait
+	on one of their timeline values, a submission on another queue waiting for them, or a fence.
+	*/
 	class Queue : IVkWrapper<VkQueue>
 	{
 	  public:
@@ -28,9 +36,42 @@ namespace vkt
 
 		void waitIdle()
 		{
+			flush();
+
+			std::lock_guard<std::mutex> lock(mutex);
 			VK_CHECK_RESULT(vkQueueWaitIdle(vkQueue));
 		}
 
+		/**
+		Adds the command buffer (ended) to the batch, waiting at waitStage for waitSemaphore and for the timeline
+		waits. Fences and binary semaphores flush the batch right away.
+		@return the point of the queue timeline signaled when the command buffer has completed
+		*/
+		TimelinePoint submit(VkCommandBuffer commandBuffer, VkFence fence, VkSemaphore signalSemaphore,
+							 VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage,
+							 std::initializer_list<TimelineWait> timelineWaits);
+
+		/**
+		Gives the batched submissions to the driver.
+		*/
+		void flush();
+
+		/**
+		Signaled by every submission to this queue.
+		*/
+		Timeline* getTimeline()
+		{
+			return timeline;
+		}
+
+		/**
+		Waits for the submissions made so far (by every user of the queue), not for the ones submitted while waiting.
+		*/
+		void waitSubmitted()
+		{
+			timeline->waitLast();
+		}
+
 		VkDevice getVkDevice()
 		{
 			return vkDevice;
@@ -40,5 +81,23 @@ namespace vkt
 		VkDevice vkDevice = VK_NULL_HANDLE;
 		VkQueue vkQueue = VK_NULL_HANDLE;
 		std::optional<uint32_t> queueFamilyIndex;
+		Timeline* timeline;
+
+		struct Submission
+		{
+			VkCommandBuffer commandBuffer;
+			std::vector<VkSemaphore> waitSemaphores;
+			std::vector<VkPipelineStageFlags> waitStages;
+			std::vector<uint64_t> waitValues;
+			std::vector<VkSemaphore> signalSemaphores;
+			std::vector<uint64_t> signalValues;
+		};
+
+		// guards the batch, the timeline values reservation (they must be signaled in submission order) and
+		// vkQueueSubmit
+		std::mutex mutex;
+		std::vector<Submission> pending;
+
+		void flushLocked(VkFence fence);
 	};
 } // namespace vkt
@@ -0,0 +1,523 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#include "vktrendergraph.h"
+
+namespace vkt
+{
+	namespace
+	{
+		constexpr VkAccessFlags writeAccesses = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+												VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+												VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+												VK_ACCESS_MEMORY_WRITE_BIT;
+
+		RenderGraph::ImageState requiredState(RenderGraph::Usage usage)
+		{
+			switch (usage)
+			{
+				case RenderGraph::Usage::TransferSrc:
+					return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+							 VK_ACCESS_TRANSFER_READ_BIT };
+				case RenderGraph::Usage::TransferDst:
+					return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+							 VK_ACCESS_TRANSFER_WRITE_BIT };
+				case RenderGraph::Usage::Sampled:
+					return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+							 VK_ACCESS_SHADER_READ_BIT };
+				case RenderGraph::Usage::ComputeSampled:
+					return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+							 VK_ACCESS_SHADER_READ_BIT };
+				case RenderGraph::Usage::ColorAttachment:
+					return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+							 VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT };
+				case RenderGraph::Usage::DepthAttachment:
+					return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+							 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+							 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+								 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+				case RenderGraph::Usage::StorageRead:
+					return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+				case RenderGraph::Usage::StorageWrite:
+				default:
+					return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+							 VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT };
+			}
+		}
+
+		VkImageUsageFlags usageFlags(RenderGraph::Usage usage)
+		{
+			switch (usage)
+			{
+				case RenderGraph::Usage::TransferSrc:
+					return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+				case RenderGraph::Usage::TransferDst:
+					return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+				case RenderGraph::Usage::Sampled:
+				case RenderGraph::Usage::ComputeSampled:
+					return VK_IMAGE_USAGE_SAMPLED_BIT;
+				case RenderGraph::Usage::ColorAttachment:
+					return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+				case RenderGraph::Usage::DepthAttachment:
+					return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+				default:
+					return VK_IMAGE_USAGE_STORAGE_BIT;
+			}
+		}
+
+		VkImageAspectFlags aspectOf(VkFormat format)
+		{
+			switch (format)
+			{
+				case VK_FORMAT_D16_UNORM:
+				case VK_FORMAT_X8_D24_UNORM_PACK32:
+				case VK_FORMAT_D32_SFLOAT:
+					return VK_IMAGE_ASPECT_DEPTH_BIT;
+				case VK_FORMAT_D16_UNORM_S8_UINT:
+				case VK_FORMAT_D24_UNORM_S8_UINT:
+				case VK_FORMAT_D32_SFLOAT_S8_UINT:
+					return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+				default:
+					return VK_IMAGE_ASPECT_COLOR_BIT;
+			}
+		}
+	} // namespace
+
+	// Pass
+
+	RenderGraph::Pass& RenderGraph::Pass::read(Resource resource, Usage usage)
+	{
+		accesses.push_back({ resource, usage, true, false });
+		return *this;
+	}
+
+	RenderGraph::Pass& RenderGraph::Pass::write(Resource resource, Usage usage)
+	{
+		accesses.push_back({ resource, usage, false, true });
+		return *this;
+	}
+
+	RenderGraph::Pass& RenderGraph::Pass::modify(Resource resource, Usage usage)
+	{
+		accesses.push_back({ resource, usage, true, true });
+		return *this;
+	}
+
+	RenderGraph::Pass& RenderGraph::Pass::sideEffects()
+	{
+		hasSideEffects = true;
+		return *this;
+	}
+
+	// RenderGraph
+
+	RenderGraph::RenderGraph(deletion_queue& deletionQueue, Logical::Device* vktDevice) : vktDevice(vktDevice)
+	{
+		deletionQueue.push_function([=]() { destroy(); });
+	}
+
+	RenderGraph::Resource RenderGraph::importImage(Images::AllocatedImage* image, ImageState state)
+	{
+		resources.push_back({ image, image->getExtent(), image->getFormat(), 0, state, {}, -1, -1, image->getImage(),
+							  image->getImageView() });
+		return static_cast<Resource>(resources.size() - 1);
+	}
+
+	RenderGraph::Resource RenderGraph::createImage(VkExtent2D extent, VkFormat format)
+	{
+		// the memory may have been used by any other transient before, in this frame or in a previous one
+		resources.push_back({ nullptr, extent, format, 0,
+							  ImageState{ VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+										  VK_ACCESS_MEMORY_WRITE_BIT },
+							  {}, -1, -1, VK_NULL_HANDLE, VK_NULL_HANDLE });
+		return static_cast<Resource>(resources.size() - 1);
+	}
+
+	void RenderGraph::exportImage(Resource resource, ImageState state)
+	{
+		resources[resource].exportState = state;
+	}
+
+	RenderGraph::Pass& RenderGraph::addPass(std::string name, std::function<void(VkCommandBuffer)> record)
+	{
+		Pass& pass = passes.emplace_back();
+		pass.name = std::move(name);
+		pass.record = std::move(record);
+		return pass;
+	}
+
+	std::vector<bool> RenderGraph::cull()
+	{
+		std::vector<bool> kept(passes.size(), false);
+
+		// walking back from the exports, a pass is needed if it writes something read later (or exported)
+		std::vector<bool> needed(resources.size(), false);
+		for (size_t r = 0; r < resources.size(); r++)
+			needed[r] = resources[r].exportState.has_value();
+
+		for (size_t i = passes.size(); i-- > 0;)
+		{
+			Pass& pass = passes[i];
+
+			kept[i] = pass.hasSideEffects || std::any_of(pass.accesses.begin(), pass.accesses.end(),
+														 [&](const Pass::Access& access) {
+															 return access.writes && needed[access.resource];
+														 });
+			if (!kept[i])
+				continue;
+
+			// what it overwrites isn't needed from the passes before, what it reads is
+			for (const Pass::Access& access : pass.accesses)
+				if (access.writes && !access.reads)
+					needed[access.resource] = false;
+			for (const Pass::Access& access : pass.accesses)
+				if (access.reads)
+					needed[access.resource] = true;
+		}
+
+		return kept;
+	}
+
+	VkImage RenderGraph::createTransientImage(const ImageResource& resource)
+	{
+		VkImageCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		createInfo.imageType = VK_IMAGE_TYPE_2D;
+		createInfo.format = resource.format;
+		createInfo.extent = { resource.extent.width, resource.extent.height, 1 };
+		createInfo.mipLevels = 1;
+		createInfo.arrayLayers = 1;
+		createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		createInfo.usage = resource.usage;
+		createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkImage image;
+		VK_CHECK_RESULT(vkCreateImage(vktDevice->vk(), &createInfo, nullptr, &image));
+		return image;
+	}
+
+	void RenderGraph::placeTransients()
+	{
+		for (Heap& heap : heaps)
+			heap.busyUntil = -1;
+
+		// in order of first use, each one goes to the smallest heap that is free by then
+
+		std::vector<Resource> transients;
+		for (Resource r = 0; r < resources.size(); r++)
+			if (!resources[r].image && resources[r].firstPass >= 0)
+				transients.push_back(r);
+
+		std::sort(transients.begin(), transients.end(),
+				  [&](Resource a, Resource b) { return resources[a].firstPass < resources[b].firstPass; });
+
+		for (Resource r : transients)
+		{
+			ImageResource& resource = resources[r];
+
+			auto sameImage = [&](const TransientImage& transient) {
+				return transient.extent.width == resource.extent.width &&
+					   transient.extent.height == resource.extent.height && transient.format == resource.format &&
+					   transient.usage == resource.usage;
+			};
+
+			// the requirements are known if an image like this was created before, on any heap
+
+			VkImage image = VK_NULL_HANDLE;
+			VkMemoryRequirements requirements;
+
+			auto known = std::find_if(transientImages.begin(), transientImages.end(), sameImage);
+			if (known != transientImages.end())
+				requirements = known->requirements;
+			else
+			{
+				image = createTransientImage(resource);
+				vkGetImageMemoryRequirements(vktDevice->vk(), image, &requirements);
+			}
+
+			size_t heapIndex = heaps.size();
+			for (size_t h = 0; h < heaps.size(); h++)
+			{
+				const VmaAllocationInfo& info = heaps[h].allocationInfo;
+
+				if (heaps[h].busyUntil >= resource.firstPass || info.size < requirements.size ||
+					!(requirements.memoryTypeBits & (1u << info.memoryType)) || info.offset % requirements.alignment)
+					continue;
+
+				if (heapIndex == heaps.size() || info.size < heaps[heapIndex].allocationInfo.size)
+					heapIndex = h;
+			}
+
+			if (heapIndex == heaps.size())
+			{
+				VmaAllocationCreateInfo allocationCreateInfo{};
+				allocationCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+				Heap heap{};
+				VK_CHECK_RESULT(vmaAllocateMemory(vktDevice->vmaAllocator, &requirements, &allocationCreateInfo,
+												  &heap.allocation, &heap.allocationInfo));
+				heaps.push_back(heap);
+			}
+
+			heaps[heapIndex].busyUntil = resource.lastPass;
+			heaps[heapIndex].lastExecution = executionCount;
+
+			// the image bound to that heap
+
+			auto placed = std::find_if(transientImages.begin(), transientImages.end(),
+									   [&](const TransientImage& transient) {
+										   return sameImage(transient) && transient.heap == heapIndex;
+									   });
+
+			if (placed == transientImages.end())
+			{
+				if (!image)
+					image = createTransientImage(resource);
+
+				VK_CHECK_RESULT(vmaBindImageMemory(vktDevice->vmaAllocator, heaps[heapIndex].allocation, image));
+
+				VkImageViewCreateInfo viewInfo{};
+				viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				viewInfo.image = image;
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewInfo.format = resource.format;
+				viewInfo.subresourceRange = { aspectOf(resource.format), 0, 1, 0, 1 };
+
+				VkImageView view;
+				VK_CHECK_RESULT(vkCreateImageView(vktDevice->vk(), &viewInfo, nullptr, &view));
+
+				transientImages.push_back(
+					{ resource.extent, resource.format, resource.usage, requirements, heapIndex, image, view });
+				placed = transientImages.end() - 1;
+			}
+			else if (image)
+				vkDestroyImage(vktDevice->vk(), image, nullptr);
+
+			placed->lastExecution = executionCount;
+
+			resource.vkImage = placed->image;
+			resource.vkImageView = placed->view;
+		}
+	}
+
+	void RenderGraph::execute(VkCommandBuffer cmd)
+	{
+		executionCount++;
+
+		std::vector<bool> kept = cull();
+
+		// lifetimes and usage flags from the passes that run
+
+		for (size_t i = 0; i < passes.size(); i++)
+		{
+			if (!kept[i])
+				continue;
+
+			for (const Pass::Access& access : passes[i].accesses)
+			{
+				ImageResource& resource = resources[access.resource];
+				if (resource.firstPass < 0)
+					resource.firstPass = static_cast<int64_t>(i);
+				resource.lastPass = static_cast<int64_t>(i);
+				resource.usage |= usageFlags(access.usage);
+			}
+		}
+
+		placeTransients();
+
+		// moves the resources to the states, the barriers of a pass go together
+
+		auto transition = [&](std::vector<std::pair<Resource, ImageState>> targets, std::vector<bool> discards) {
+			std::vector<VkImageMemoryBarrier> barriers;
+			VkPipelineStageFlags srcStages = 0, dstStages = 0;
+
+			for (size_t t = 0; t < targets.size(); t++)
+			{
+				auto& [r, target] = targets[t];
+				ImageResource& resource = resources[r];
+				ImageState& current = resource.state;
+
+				VkAccessFlags pendingWrites = current.accesses & writeAccesses;
+				bool writes = target.accesses & writeAccesses;
+
+				// reads after reads in the same layout only add up
+				if (current.layout == target.layout && !pendingWrites && !writes)
+				{
+					current.stages |= target.stages;
+					current.accesses |= target.accesses;
+					continue;
+				}
+
+				VkImageMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.srcAccessMask = pendingWrites;
+				barrier.dstAccessMask = target.accesses;
+				barrier.oldLayout = discards[t] ? VK_IMAGE_LAYOUT_UNDEFINED : current.layout;
+				barrier.newLayout = target.layout;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = resource.vkImage;
+				barrier.subresourceRange = { aspectOf(resource.format), 0, 1, 0,
+											 resource.image ? resource.image->getArrayLayers() : 1 };
+				barriers.push_back(barrier);
+
+				srcStages |= current.stages ? current.stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+				dstStages |= target.stages;
+
+				current = target;
+			}
+
+			if (!barriers.empty())
+				vkCmdPipelineBarrier(cmd, srcStages, dstStages, 0, 0, nullptr, 0, nullptr,
+									 static_cast<uint32_t>(barriers.size()), barriers.data());
+		};
+
+		for (size_t i = 0; i < passes.size(); i++)
+		{
+			if (!kept[i])
+				continue;
+
+			std::vector<std::pair<Resource, ImageState>> targets;
+			std::vector<bool> discards;
+			for (const Pass::Access& access : passes[i].accesses)
+			{
+				targets.push_back({ access.resource, requiredState(access.usage) });
+				discards.push_back(access.writes && !access.reads);
+			}
+
+			transition(targets, discards);
+
+			passes[i].record(cmd);
+		}
+
+		// exported images are left as requested
+
+		std::vector<std::pair<Resource, ImageState>> exports;
+		for (Resource r = 0; r < resources.size(); r++)
+			if (resources[r].exportState)
+				exports.push_back({ r, *resources[r].exportState });
+
+		transition(exports, std::vector<bool>(exports.size(), false));
+
+		passes.clear();
+		resources.clear();
+	}
+
+	VkImage RenderGraph::getImage(Resource resource)
+	{
+		return resources[resource].vkImage;
+	}
+
+	VkImageView RenderGraph::getImageView(Resource resource)
+	{
+		return resources[resource].vkImageView;
+	}
+
+	VkExtent2D RenderGraph::getExtent(Resource resource)
+	{
+		return resources[resource].extent;
+	}
+
+	VkFramebuffer RenderGraph::getFramebuffer(VkRenderPass renderPass, std::vector<Resource> attachments)
+	{
+		std::vector<VkImageView> views;
+		for (Resource attachment : attachments)
+			views.push_back(getImageView(attachment));
+
+		auto found = std::find_if(framebuffers.begin(), framebuffers.end(), [&](const Framebuffer& framebuffer) {
+			return framebuffer.renderPass == renderPass && framebuffer.views == views;
+		});
+		if (found != framebuffers.end())
+			return found->framebuffer;
+
+		VkExtent2D extent = getExtent(attachments.front());
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = renderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+		framebufferInfo.pAttachments = views.data();
+		framebufferInfo.width = extent.width;
+		framebufferInfo.height = extent.height;
+		framebufferInfo.layers = 1;
+
+		VkFramebuffer framebuffer;
+		VK_CHECK_RESULT(vkCreateFramebuffer(vktDevice->vk(), &framebufferInfo, nullptr, &framebuffer));
+
+		framebuffers.push_back({ renderPass, views, framebuffer });
+		return framebuffer;
+	}
+
+	void RenderGraph::destroyFramebuffers(VkImageView view)
+	{
+		std::erase_if(framebuffers, [&](const Framebuffer& framebuffer) {
+			if (std::find(framebuffer.views.begin(), framebuffer.views.end(), view) == framebuffer.views.end())
+				return false;
+			vkDestroyFramebuffer(vktDevice->vk(), framebuffer.framebuffer, nullptr);
+			return true;
+		});
+	}
+
+	void RenderGraph::releaseUnused(uint64_t executions)
+	{
+		auto unused = [&](uint64_t lastExecution) { return executionCount - lastExecution >= executions; };
+
+		std::erase_if(transientImages, [&](const TransientImage& transient) {
+			if (!unused(transient.lastExecution))
+				return false;
+			destroyFramebuffers(transient.view);
+			vkDestroyImageView(vktDevice->vk(), transient.view, nullptr);
+			vkDestroyImage(vktDevice->vk(), transient.image, nullptr);
+			return true;
+		});
+
+		// heaps without images left, the others move down over them
+
+		std::vector<size_t> heapIndices(heaps.size());
+		std::vector<Heap> kept;
+
+		for (size_t h = 0; h < heaps.size(); h++)
+		{
+			bool bound = std::any_of(transientImages.begin(), transientImages.end(),
+									 [&](const TransientImage& transient) { return transient.heap == h; });
+
+			if (!bound && unused(heaps[h].lastExecution))
+			{
+				vmaFreeMemory(vktDevice->vmaAllocator, heaps[h].allocation);
+				continue;
+			}
+
+			heapIndices[h] = kept.size();
+			kept.push_back(heaps[h]);
+		}
+
+		for (TransientImage& transient : transientImages)
+			transient.heap = heapIndices[transient.heap];
+
+		heaps = std::move(kept);
+	}
+
+	void RenderGraph::destroy()
+	{
+		for (Framebuffer& framebuffer : framebuffers)
+			vkDestroyFramebuffer(vktDevice->vk(), framebuffer.framebuffer, nullptr);
+
+		for (TransientImage& transient : transientImages)
+		{
+			vkDestroyImageView(vktDevice->vk(), transient.view, nullptr);
+			vkDestroyImage(vktDevice->vk(), transient.image, nullptr);
+		}
+
+		for (Heap& heap : heaps)
+			vmaFreeMemory(vktDevice->vmaAllocator, heap.allocation);
+
+		delete (this);
+	}
+} // namespace vkt
@@ -0,0 +1,202 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#pragma once
+
+#include "vktcommon.h"
+#include "vktdevices.h"
+#include "vktimages.h"
+
+namespace vkt
+{
+	/**
+	The gpu work of a frame on one queue, as passes that declare how they use the images.
+	Executing it culls the passes nobody needs the writes of, records the barriers and layout transitions between the
+	passes, and places the transient images in shared memory: transients used by passes that don't overlap alias the
+	same memory, which is kept for the next frames.
+	Imported images enter in the state given at import, and are left in the state given at export (exported images
+	are what the graph is executed for).
+	Passes and resources are cleared by execute, the memory, images and framebuffers stay until released as unused or
+	destroyed.
+	*/
+	class RenderGraph
+	{
+	  public:
+		RenderGraph(deletion_queue& deletionQueue, Logical::Device* vktDevice);
+
+		using Resource = uint32_t;
+
+		/**
+		How a pass uses an image
+		*/
+		enum class Usage
+		{
+			TransferSrc,
+			TransferDst,
+			Sampled,		 // fragment shader
+			ComputeSampled,	 // compute shader
+			ColorAttachment, // render pass attachments stay in the attachment layout
+			DepthAttachment,
+			StorageRead, // compute shader
+			StorageWrite
+		};
+
+		/**
+		Layout and last accesses of an image, for the barriers into and out of the graph
+		*/
+		struct ImageState
+		{
+			VkImageLayout layout;
+			VkPipelineStageFlags stages;
+			VkAccessFlags accesses;
+		};
+
+		class Pass
+		{
+		  public:
+			/**
+			The contents are used
+			*/
+			Pass& read(Resource resource, Usage usage);
+			/**
+			The whole image is overwritten, the previous contents are discarded
+			*/
+			Pass& write(Resource resource, Usage usage);
+			/**
+			Written keeping the previous contents (e.g. blended over)
+			*/
+			Pass& modify(Resource resource, Usage usage);
+			/**
+			Never culled (writes something outside of the graph)
+			*/
+			Pass& sideEffects();
+
+		  private:
+			friend class RenderGraph;
+
+			struct Access
+			{
+				Resource resource;
+				Usage usage;
+				bool reads, writes;
+			};
+
+			std::string name;
+			std::function<void(VkCommandBuffer)> record;
+			std::vector<Access> accesses;
+			bool hasSideEffects = false;
+		};
+
+		Resource importImage(Images::AllocatedImage* image, ImageState state);
+		/**
+		Created by the graph, the usage flags are the ones the passes declare
+		*/
+		Resource createImage(VkExtent2D extent, VkFormat format);
+		/**
+		Left in state after the graph, its writers are kept
+		*/
+		void exportImage(Resource resource, ImageState state);
+
+		/**
+		Passes run in the order they are added, record is called by execute (with the images of the resources)
+		*/
+		Pass& addPass(std::string name, std::function<void(VkCommandBuffer)> record);
+
+		/**
+		Records the needed passes in cmd, then clears them
+		*/
+		void execute(VkCommandBuffer cmd);
+
+		/**
+		Valid while recording
+		*/
+		VkImage getImage(Resource resource);
+		VkImageView getImageView(Resource resource);
+		VkExtent2D getExtent(Resource resource);
+
+		/**
+		Of the attachment images (cached), valid while recording
+		*/
+		VkFramebuffer getFramebuffer(VkRenderPass renderPass, std::vector<Resource> attachments);
+		/**
+		Destroys the cached framebuffers using view, before an imported image goes away
+		*/
+		void destroyFramebuffers(VkImageView view);
+
+		/**
+		Frees the transient images, and the heaps, that none of the last executions used (0 frees them all).
+		The gpu must be done with the executions before those
+		*/
+		void releaseUnused(uint64_t executions);
+
+	  private:
+		struct ImageResource
+		{
+			// imported (image is set) or transient
+			Images::AllocatedImage* image;
+			VkExtent2D extent;
+			VkFormat format;
+			VkImageUsageFlags usage;
+			ImageState state;
+			std::optional<ImageState> exportState;
+			// first and last kept pass using it (-1 if none)
+			int64_t firstPass, lastPass;
+			VkImage vkImage;
+			VkImageView vkImageView;
+		};
+
+		// memory shared by the transients, as many as the transients alive at once in the worst recent frame
+		struct Heap
+		{
+			VmaAllocation allocation;
+			VmaAllocationInfo allocationInfo;
+			// the last pass using it, in the frame being executed
+			int64_t busyUntil;
+			uint64_t lastExecution;
+		};
+
+		// transient images created on a heap, reused by every frame that places the same image there
+		struct TransientImage
+		{
+			VkExtent2D extent;
+			VkFormat format;
+			VkImageUsageFlags usage;
+			VkMemoryRequirements requirements;
+			size_t heap;
+			VkImage image;
+			VkImageView view;
+			uint64_t lastExecution;
+		};
+
+		struct Framebuffer
+		{
+			VkRenderPass renderPass;
+			std::vector<VkImageView> views;
+			VkFramebuffer framebuffer;
+		};
+
+		std::vector<bool> cull();
+		void placeTransients();
+		VkImage createTransientImage(const ImageResource& resource);
+
+		void destroy();
+
+		Logical::Device* vktDevice;
+
+		std::vector<ImageResource> resources;
+		// references stay valid while passes are added
+		std::deque<Pass> passes;
+
+		std::vector<Heap> heaps;
+		std::vector<TransientImage> transientImages;
+		std::vector<Framebuffer> framebuffers;
+
+		// executions so far, the transients and heaps are stamped with the last one using them
+		uint64_t executionCount = 0;
+	};
+} // namespace vkt
@@ -51,6 +51,13 @@ namespace vkt
 			{
 				return indices;
 			}
+			/**
+			Around the vertices (center of their bounds, radius), for culling
+			*/
+			glm::vec4 getBoundingSphere()
+			{
+				return boundingSphere;
+			}
 
 		  private:
 			Logical::Device* vktDevice = nullptr;
@@ -59,6 +66,7 @@ namespace vkt
 
 			std::vector<Vertex> vertices{};
 			std::vector<uint32_t> indices{};
+			glm::vec4 boundingSphere{ 0.f };
 		};
 
 		struct Material
@@ -66,6 +74,8 @@ namespace vkt
 			VkPipeline pipeline;
 			VkPipelineLayout pipelineLayout;
 			VkPipelineCache pipelineCache;
+			// compute materials
+			std::array<uint32_t, 3> workgroupSize{ 1, 1, 1 };
 
 			Material& registerBindDescriptorSets(uint32_t firstSet, uint32_t descriptorSetCount,
 												 const VkDescriptorSet* pDescriptorSets, uint32_t dynamicOffsetCount,
@@ -86,6 +96,13 @@ namespace vkt
 				}
 			}
 
+			// compute materials, enough groups to cover width by height
+			void cmdDispatch(VkCommandBuffer commandBuffer, uint32_t width, uint32_t height)
+			{
+				vkCmdDispatch(commandBuffer, (width + workgroupSize[0] - 1) / workgroupSize[0],
+							  (height + workgroupSize[1] - 1) / workgroupSize[1], 1);
+			}
+
 			template <typename P>
 			void cmdPushConstants(VkCommandBuffer commandBuffer, VkShaderStageFlagBits stages, P* constants, uint32_t offset)
 			{
@@ -0,0 +1,66 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#include "vkttimeline.h"
+
+namespace vkt
+{
+	// class Timeline
+
+	Timeline::Timeline(deletion_queue& deletionQueue, VkDevice device) : vkDevice(device)
+	{
+		deletionQueue.push_function([=]() { delete (this); });
+
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+
+		VK_CHECK_RESULT(vkCreateSemaphore(vkDevice, &semaphoreInfo, nullptr, &vkSemaphore));
+
+		deletionQueue.push_function([=]() { vkDestroySemaphore(vkDevice, vkSemaphore, nullptr); });
+	}
+
+	uint64_t Timeline::getCompletedValue()
+	{
+		uint64_t value;
+		VK_CHECK_RESULT(vkGetSemaphoreCounterValue(vkDevice, vkSemaphore, &value));
+		advanceCompletedValue(value);
+		return value;
+	}
+
+	void Timeline::advanceCompletedValue(uint64_t value)
+	{
+		// only moves forward, another thread may have seen a later value meanwhile
+		uint64_t seen = completedValue;
+		while (seen < value && !completedValue.compare_exchange_weak(seen, value))
+			;
+	}
+
+	void Timeline::wait(uint64_t value)
+	{
+		if (value <= completedValue)
+			return;
+
+		ensureSubmitted(value);
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &vkSemaphore;
+		waitInfo.pValues = &value;
+
+		VK_CHECK_RESULT(vkWaitSemaphores(vkDevice, &waitInfo, UINT64_MAX));
+
+		advanceCompletedValue(value);
+	}
+} // namespace vkt
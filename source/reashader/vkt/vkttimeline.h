@@ -0,0 +1,136 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+#pragma once
+
+#include "vktcommon.h"
+
+#include <atomic>
+
+namespace vkt
+{
+	/**
+	A timeline semaphore (Vulkan 1.2), every submission signals the next value.
+	Cpu waits and resource reuse target exact values instead of idle queues.
+	Values can be reserved by submissions that are still batched (not given to the driver yet), waiting for them
+	flushes the batch first.
+	*/
+	class Timeline : IVkWrapper<VkSemaphore>
+	{
+	  public:
+		Timeline(deletion_queue& deletionQueue, VkDevice device);
+
+		VkSemaphore vk()
+		{
+			return vkSemaphore;
+		}
+
+		/**
+		Returns the value the next submission has to signal (values only increase).
+		*/
+		uint64_t reserve()
+		{
+			return ++lastValue;
+		}
+
+		/**
+		The last value reserved for a submission.
+		*/
+		uint64_t getLastValue()
+		{
+			return lastValue;
+		}
+
+		/**
+		The last value signaled by the gpu.
+		*/
+		uint64_t getCompletedValue();
+
+		bool reached(uint64_t value)
+		{
+			if (value <= completedValue)
+				return true;
+
+			ensureSubmitted(value);
+			return value <= getCompletedValue();
+		}
+
+		/**
+		Called by the owner of the batched submissions when they are given to the driver.
+		*/
+		void setSubmittedValue(uint64_t value)
+		{
+			submittedValue = value;
+		}
+
+		/**
+		Flushes the batched submissions if value is still in there (it would never be signaled otherwise).
+		*/
+		void ensureSubmitted(uint64_t value)
+		{
+			if (value > submittedValue && flushPending)
+				flushPending();
+		}
+
+		// flushes the batched submissions signaling this timeline
+		std::function<void()> flushPending;
+
+		/**
+		Blocks until the gpu has signaled value.
+		*/
+		void wait(uint64_t value);
+
+		/**
+		Blocks until everything submitted so far is done (instead of draining the whole queue).
+		*/
+		void waitLast()
+		{
+			wait(lastValue);
+		}
+
+	  private:
+		void advanceCompletedValue(uint64_t value);
+
+		VkDevice vkDevice = VK_NULL_HANDLE;
+		VkSemaphore vkSemaphore = VK_NULL_HANDLE;
+		// timelines of shared queues are used from multiple threads
+		std::atomic<uint64_t> lastValue{ 0 };
+		std::atomic<uint64_t> submittedValue{ 0 };
+		// cached, so polling reached values doesn't call into the driver
+		std::atomic<uint64_t> completedValue{ 0 };
+	};
+
+	/**
+	A value on a timeline, returned by a submission. An empty point is always reached.
+	*/
+	struct TimelinePoint
+	{
+		Timeline* timeline{ nullptr };
+		uint64_t value{ 0 };
+
+		bool reached() const
+		{
+			return !timeline || timeline->reached(value);
+		}
+
+		void wait() const
+		{
+			if (timeline)
+				timeline->wait(value);
+		}
+	};
+
+	/**
+	A submission waits for point before stage (empty points are skipped).
+	*/
+	struct TimelineWait
+	{
+		TimelinePoint point;
+		VkPipelineStageFlags stage{ VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+	};
+} // namespace vkt
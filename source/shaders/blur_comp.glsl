@@ -0,0 +1,68 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable // MUST
+
+// gaussian blur of the previous pass output as a compute pass of the post process chain, both directions in one
+// dispatch: the tile of the group and its apron are read once into shared memory, blurred horizontally there, then
+// vertically into the target
+
+layout(local_size_x_id = 0, local_size_y_id = 1) in;
+
+// 0 is the output of the previous pass, then the named intermediates of the pass
+layout(set = 0, binding = 0) uniform sampler2D postProcessInputs[5];
+layout(set = 0, binding = 1, rgba8) uniform writeonly image2D target;
+
+layout( push_constant ) uniform constants
+{
+	int objectId;
+	float videoParam;
+	int inputCount;
+} pushConstants;
+
+#define RADIUS 4
+
+const float weights[RADIUS + 1] = float[](0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162);
+
+shared vec4 tile[gl_WorkGroupSize.y + 2 * RADIUS][gl_WorkGroupSize.x + 2 * RADIUS];
+shared vec4 rows[gl_WorkGroupSize.y + 2 * RADIUS][gl_WorkGroupSize.x];
+
+void main()
+{
+	uvec2 groupSize = gl_WorkGroupSize.xy;
+	uvec2 local = gl_LocalInvocationID.xy;
+	ivec2 targetSize = imageSize(target);
+	ivec2 origin = ivec2(gl_WorkGroupID.xy * groupSize) - RADIUS;
+
+	// the input may be larger than the target (the ingested frame at a reduced render scale), sampled at the
+	// target texel centers, clamped at the edges
+
+	for (uint y = local.y; y < groupSize.y + 2 * RADIUS; y += groupSize.y)
+		for (uint x = local.x; x < groupSize.x + 2 * RADIUS; x += groupSize.x)
+		{
+			ivec2 texel = clamp(origin + ivec2(x, y), ivec2(0), targetSize - 1);
+			tile[y][x] = textureLod(postProcessInputs[0], (vec2(texel) + 0.5) / vec2(targetSize), 0);
+		}
+
+	barrier();
+
+	// horizontal, the apron rows too (read by the vertical pass)
+
+	for (uint y = local.y; y < groupSize.y + 2 * RADIUS; y += groupSize.y)
+	{
+		vec4 sum = tile[y][local.x + RADIUS] * weights[0];
+		for (int i = 1; i <= RADIUS; i++)
+			sum += (tile[y][local.x + RADIUS - i] + tile[y][local.x + RADIUS + i]) * weights[i];
+		rows[y][local.x] = sum;
+	}
+
+	barrier();
+
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	if (any(greaterThanEqual(pixel, targetSize)))
+		return;
+
+	vec4 sum = rows[local.y + RADIUS][local.x] * weights[0];
+	for (int i = 1; i <= RADIUS; i++)
+		sum += (rows[local.y + RADIUS - i][local.x] + rows[local.y + RADIUS + i][local.x]) * weights[i];
+
+	imageStore(target, pixel, sum);
+}
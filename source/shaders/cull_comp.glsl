@@ -0,0 +1,80 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable // MUST
+
+// frustum culling of the scene objects, one invocation per object: the visible ones get an indirect draw in the range
+// of their batch (same material and mesh), their count is the draw count of the batch
+
+layout(local_size_x_id = 0) in;
+
+struct ObjectData{
+	mat4 localTransform;
+	vec4 boundingSphere; // model space, w is the radius
+	uint firstDraw; // of the batch
+	uint batch;
+	uint elementCount; // indices, or vertices for the meshes without index buffer
+	uint pad;
+};
+
+// VkDrawIndexedIndirectCommand, the first four words are a VkDrawIndirectCommand too
+struct DrawCommand{
+	uint elementCount;
+	uint instanceCount;
+	uint firstElement;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+// bound to the objects of the scene only
+layout(std430, set = 0, binding = 0) readonly buffer ObjectBuffer{
+	ObjectData objects[];
+} objectBuffer;
+
+layout(std430, set = 0, binding = 1) writeonly buffer DrawBuffer{
+	DrawCommand commands[];
+} drawBuffer;
+
+// cleared before the dispatch
+layout(std430, set = 0, binding = 2) buffer DrawCountBuffer{
+	uint counts[];
+} drawCountBuffer;
+
+// model matrix of each draw, read by the vertex shader
+layout(std430, set = 0, binding = 3) writeonly buffer InstanceBuffer{
+	mat4 models[];
+} instanceBuffer;
+
+layout( push_constant ) uniform constants
+{
+	mat4 viewproj;
+	mat4 sceneTransform; // applied to all the objects
+} pushConstants;
+
+void main()
+{
+	uint id = gl_GlobalInvocationID.x;
+	if (id >= uint(objectBuffer.objects.length()))
+		return;
+
+	ObjectData object = objectBuffer.objects[id];
+	mat4 model = pushConstants.sceneTransform * object.localTransform;
+
+	// world space sphere, the radius scaled by the largest axis scale
+
+	vec3 center = (model * vec4(object.boundingSphere.xyz, 1.0)).xyz;
+	float scale = max(max(length(model[0].xyz), length(model[1].xyz)), length(model[2].xyz));
+	float radius = object.boundingSphere.w * scale;
+
+	// planes of the frustum from the rows of the matrix (w + z for the near one, conservative with a 0 to 1 depth)
+
+	mat4 m = transpose(pushConstants.viewproj);
+	vec4 planes[6] = vec4[](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2]);
+
+	for (int i = 0; i < 6; i++)
+		if (dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz))
+			return;
+
+	uint draw = object.firstDraw + atomicAdd(drawCountBuffer.counts[object.batch], 1u);
+
+	drawBuffer.commands[draw] = DrawCommand(object.elementCount, 1u, 0u, 0, 0u);
+	instanceBuffer.models[draw] = model;
+}
@@ -0,0 +1,7 @@
+// per pixel snippet of the post process chain (fused with its neighbours, no #version or bindings of its own)
+// color is the output of the previous step, pushConstants are the DefaultPushConstants
+
+vec4 pixel(vec4 color)
+{
+	return vec4(mix(color.rgb, 1.0 - color.rgb, pushConstants.videoParam), color.a);
+}
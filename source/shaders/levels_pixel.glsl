@@ -0,0 +1,10 @@
+// per pixel snippet of the post process chain, stretches the levels between black and white points
+// (declarations stay inside pixel, a snippet can appear more than once in a fused pass)
+
+vec4 pixel(vec4 color)
+{
+	const float blackPoint = 0.0625;
+	const float whitePoint = 0.9375;
+
+	return vec4(clamp((color.rgb - blackPoint) / (whitePoint - blackPoint), 0.0, 1.0), color.a);
+}
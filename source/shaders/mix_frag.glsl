@@ -0,0 +1,16 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable // MUST
+
+// the unprocessed frame, blended over the rendered one with the dry amount (blend constants)
+
+layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec2 texCoord;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 1) uniform sampler2D sampledFrame;
+
+void main()
+{
+	outColor = texture(sampledFrame, texCoord);
+}
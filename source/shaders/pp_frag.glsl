@@ -7,11 +7,19 @@ layout (location = 1) in vec2 texCoord;
 layout(location = 0) out vec4 outColor;
 
 layout(set = 0, binding = 1) uniform sampler2D sampledFrame;
+// every input of the video processor at frame size, layer i is input i (0 is sampledFrame)
+// updated only when there's more than one input, valid below inputCount
+layout(set = 0, binding = 2) uniform sampler2DArray inputLayers;
+
+// post process chain: 0 is the output of the previous pass (sampledFrame for the first pass), then the named
+// intermediates the pass reads, unused ones are sampledFrame
+layout(set = 1, binding = 0) uniform sampler2D postProcessInputs[5];
 
 layout( push_constant ) uniform constants
 {
 	int objectId;
 	float videoParam;
+	int inputCount;
 } pushConstants;
 
 void main()
@@ -19,5 +27,6 @@ void main()
 	//outColor = vec4(fragColor + sceneData.ambientColor.xyz, 1.0);
 	//outColor = vec4(texCoord.x,texCoord.y,0.5f,1.0f);
 	vec4 color = texture(sampledFrame,texCoord).xyzw;
-	outColor = color+pushConstants.videoParam*vec4(0.5f,0.5f,0.5f, 0);
+	// drawn without blending straight from the ingested frame, same as the effect alpha blended over the frame
+	outColor = vec4(color.rgb + color.a*pushConstants.videoParam*vec3(0.5f,0.5f,0.5f), color.a);
 }
\ No newline at end of file
@@ -0,0 +1,7 @@
+// per pixel snippet of the post process chain, video param 0 is grayscale and 1 keeps the colors
+
+vec4 pixel(vec4 color)
+{
+	float luma = dot(color.rgb, vec3(0.2126, 0.7152, 0.0722));
+	return vec4(mix(vec3(luma), color.rgb, pushConstants.videoParam), color.a);
+}
@@ -16,23 +16,19 @@ layout(set = 0, binding = 0) uniform  CameraBuffer{
 	mat4 viewproj;
 } cameraData;
 
-struct ObjectData{
-	mat4 finalModelMatrix;
-};
-
 layout( push_constant ) uniform constants
 {
-	int objectId;
+	int objectId; // first draw of the batch
 	float videoParam;
 } pushConstants;
 
-//all object matrices
-layout(std140,set = 1, binding = 0) readonly buffer ObjectBuffer{
-	ObjectData objects[];
-} objectBuffer;
+// model matrix of each draw, written by the culling
+layout(std430, set = 1, binding = 0) readonly buffer InstanceBuffer{
+	mat4 models[];
+} instanceBuffer;
 
 void main() {
-	mat4 modelMatrix = objectBuffer.objects[pushConstants.objectId].finalModelMatrix;
+	mat4 modelMatrix = instanceBuffer.models[pushConstants.objectId + gl_DrawID];
 	mat4 transformMatrix = (cameraData.viewproj * modelMatrix);
 	gl_Position = transformMatrix * vec4(vPosition, 1.0f);
 	fragColor = vColor;
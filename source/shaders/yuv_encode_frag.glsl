@@ -0,0 +1,92 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable // MUST
+
+// encodes the rendered frame as YV12 or YUY2
+// every texel of the (r8) target is one byte of the tightly packed planes, row by row
+
+layout(location = 0) out vec4 outByte;
+
+layout(set = 0, binding = 0) uniform sampler2D renderedFrame;
+
+layout( push_constant ) uniform constants
+{
+	int format; // 0 YV12, 1 YUY2
+	int matrix; // 0 BT.601, 1 BT.709
+	int width;
+	int height;
+} pushConstants;
+
+vec3 rgbAt(ivec2 p)
+{
+	p = clamp(p, ivec2(0), ivec2(pushConstants.width - 1, pushConstants.height - 1));
+	return texelFetch(renderedFrame, p, 0).rgb;
+}
+
+// studio range Y, U, V normalized to bytes
+vec3 toYuv(vec3 rgb)
+{
+	// luma coefficients (Kr, Kb)
+	vec2 k = pushConstants.matrix == 1 ? vec2(0.2126f, 0.0722f) : vec2(0.299f, 0.114f);
+
+	float y = k.x * rgb.r + (1.0f - k.x - k.y) * rgb.g + k.y * rgb.b;
+	float u = (rgb.b - y) / (2.0f * (1.0f - k.y));
+	float v = (rgb.r - y) / (2.0f * (1.0f - k.x));
+
+	return vec3(16.0f + 219.0f * y, 128.0f + 224.0f * u, 128.0f + 224.0f * v) / 255.0f;
+}
+
+void main()
+{
+	ivec2 p = ivec2(gl_FragCoord.xy);
+	int w = pushConstants.width;
+	int h = pushConstants.height;
+
+	float value = 0.0f;
+
+	if (pushConstants.format == 0)
+	{
+		// 4:2:0 planar, Y plane then V plane then U plane, target is w bytes wide
+		int cw = (w + 1) / 2;
+		int ch = (h + 1) / 2;
+		int i = p.y * w + p.x;
+
+		if (i < w * h)
+		{
+			value = toYuv(rgbAt(p)).x;
+		}
+		else
+		{
+			int j = i - w * h;
+			int plane = j / (cw * ch);
+
+			if (plane < 2)
+			{
+				int k = j % (cw * ch);
+				ivec2 c = ivec2(k % cw, k / cw) * 2;
+
+				vec3 rgb = (rgbAt(c) + rgbAt(c + ivec2(1, 0)) + rgbAt(c + ivec2(0, 1)) + rgbAt(c + ivec2(1, 1))) * 0.25f;
+				vec3 yuv = toYuv(rgb);
+
+				value = plane == 0 ? yuv.z : yuv.y;
+			}
+		}
+	}
+	else
+	{
+		// 4:2:2 packed, Y0 U Y1 V for each pixel pair
+		ivec2 l = ivec2((p.x / 4) * 2, p.y);
+		int component = p.x % 4;
+
+		if (component == 0)
+			value = toYuv(rgbAt(l)).x;
+		else if (component == 2)
+			value = toYuv(rgbAt(l + ivec2(1, 0))).x;
+		else
+		{
+			vec3 yuv = toYuv((rgbAt(l) + rgbAt(l + ivec2(1, 0))) * 0.5f);
+			value = component == 1 ? yuv.y : yuv.z;
+		}
+	}
+
+	outByte = vec4(value, 0.0f, 0.0f, 1.0f);
+}
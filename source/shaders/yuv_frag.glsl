@@ -0,0 +1,68 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable // MUST
+
+// converts a native video frame (YV12 or YUY2 planes, tightly packed) to rgb
+
+layout(location = 0) out vec4 outColor;
+
+layout(std430, set = 0, binding = 0) readonly buffer FramePlanes
+{
+	uint words[];
+} framePlanes;
+
+layout( push_constant ) uniform constants
+{
+	int format; // 0 YV12, 1 YUY2
+	int matrix; // 0 BT.601, 1 BT.709
+	int width;
+	int height;
+} pushConstants;
+
+float readByte(uint index)
+{
+	return float((framePlanes.words[index >> 2] >> ((index & 3u) * 8u)) & 0xFFu);
+}
+
+void main()
+{
+	uvec2 p = uvec2(gl_FragCoord.xy);
+	uint w = uint(pushConstants.width);
+	uint h = uint(pushConstants.height);
+
+	float y, u, v;
+
+	if (pushConstants.format == 0)
+	{
+		// 4:2:0 planar, Y plane then V plane then U plane
+		uint cw = (w + 1u) / 2u;
+		uint ch = (h + 1u) / 2u;
+		uint c = (p.y / 2u) * cw + p.x / 2u;
+
+		y = readByte(p.y * w + p.x);
+		v = readByte(w * h + c);
+		u = readByte(w * h + cw * ch + c);
+	}
+	else
+	{
+		// 4:2:2 packed, Y0 U Y1 V for each pixel pair
+		uint pair = p.y * ((w + 1u) / 2u) * 4u + (p.x / 2u) * 4u;
+
+		y = readByte(pair + (p.x & 1u) * 2u);
+		u = readByte(pair + 1u);
+		v = readByte(pair + 3u);
+	}
+
+	// studio range to [0,1] luma and [-0.5,0.5] chroma
+	y = (y - 16.0f) / 219.0f;
+	u = (u - 128.0f) / 224.0f;
+	v = (v - 128.0f) / 224.0f;
+
+	// luma coefficients (Kr, Kb)
+	vec2 k = pushConstants.matrix == 1 ? vec2(0.2126f, 0.0722f) : vec2(0.299f, 0.114f);
+
+	float r = y + 2.0f * (1.0f - k.x) * v;
+	float b = y + 2.0f * (1.0f - k.y) * u;
+	float g = (y - k.x * r - k.y * b) / (1.0f - k.x - k.y);
+
+	outColor = vec4(clamp(vec3(r, g, b), 0.0f, 1.0f), 1.0f);
+}
@@ -0,0 +1,157 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+// frames stored in the rendered frame cache come back the same, from the hot tier and the compressed one, and the
+// process wide budget is shared between the caches
+
+#include "rsframecache.h"
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace ReaShader;
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                                                                                          \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		if (!(condition))                                                                                              \
+		{                                                                                                              \
+			failures++;                                                                                                \
+			printf("FAILED %s:%d: ", __FILE__, __LINE__);                                                              \
+			printf(__VA_ARGS__);                                                                                       \
+			printf("\n");                                                                                              \
+		}                                                                                                              \
+	} while (0)
+
+// a video frame, rows rowspan bytes apart
+struct Frame
+{
+	int w, h, rowspan;
+	std::vector<int> bits;
+
+	Frame(int w, int h, int padding = 0) : w(w), h(h), rowspan(w * 4 + padding), bits((size_t)rowspan * h / 4)
+	{
+	}
+
+	int& at(int x, int y)
+	{
+		return bits[(size_t)y * rowspan / 4 + x];
+	}
+};
+
+// noisy frames don't compress, flat ones do
+static Frame noisy(int w, int h, int seed)
+{
+	Frame frame(w, h, 32);
+	for (int y = 0; y < h; y++)
+		for (int x = 0; x < w; x++)
+			frame.at(x, y) = (x * 7919 + y * 104729 + seed * 15485863) ^ (x << 16);
+	return frame;
+}
+
+static Frame flat(int w, int h, int color)
+{
+	Frame frame(w, h, 32);
+	for (int y = 0; y < h; y++)
+		for (int x = 0; x < w; x++)
+			frame.at(x, y) = x < w / 2 ? color : ~color;
+	return frame;
+}
+
+static bool same(Frame& a, Frame& b)
+{
+	for (int y = 0; y < a.h; y++)
+		for (int x = 0; x < a.w; x++)
+			if (a.at(x, y) != b.at(x, y))
+				return false;
+	return true;
+}
+
+static bool fetchBack(RenderedFrameCache& cache, const RenderedFrameCache::Key& key, Frame& expected)
+{
+	// different padding than the stored frame
+	Frame fetched(expected.w, expected.h, 64);
+	return cache.fetch(key, fetched.bits.data(), fetched.rowspan) && same(fetched, expected);
+}
+
+static RenderedFrameCache::Key keyOf(int frame, int w, int h)
+{
+	return { 0x1234u + (uint64_t)frame, frame / 30.0, 0x5678u, w, h };
+}
+
+int main()
+{
+	static constexpr int w = 320, h = 180;
+	static constexpr size_t frameBytes = (size_t)w * h * 4;
+
+	// with the default budgets
+	{
+		RenderedFrameCache cache;
+		CHECK(cache.canStore(1920, 1080), "default budget doesn't fit a 1080p frame");
+
+		Frame frame = noisy(w, h, 1);
+		cache.store(keyOf(1, w, h), frame.bits.data(), frame.rowspan);
+
+		CHECK(fetchBack(cache, keyOf(1, w, h), frame), "stored frame not fetched back");
+		CHECK(!fetchBack(cache, keyOf(2, w, h), frame), "fetched a frame never stored");
+		CHECK(!fetchBack(cache, keyOf(1, w, h - 1), frame), "fetched a frame of another size");
+		CHECK(cache.getHitRatio() > 0.3f && cache.getHitRatio() < 0.4f, "hit ratio %f", cache.getHitRatio());
+	}
+
+	// room for two frames, evicted ones go compressed if they compress
+	RenderedFrameCache::setBudget(frameBytes * 2, frameBytes);
+	{
+		RenderedFrameCache cache;
+
+		Frame frames[] = { flat(w, h, 0x11223344), noisy(w, h, 2), noisy(w, h, 3) };
+		for (int i = 0; i < 3; i++)
+			cache.store(keyOf(i, w, h), frames[i].bits.data(), frames[i].rowspan);
+
+		CHECK(fetchBack(cache, keyOf(2, w, h), frames[2]), "hot frame not fetched back");
+		CHECK(fetchBack(cache, keyOf(0, w, h), frames[0]), "compressed frame not fetched back");
+		// back to hot, the noisy one was least recently used and doesn't compress
+		CHECK(!fetchBack(cache, keyOf(1, w, h), frames[1]), "evicted frame fetched back");
+		CHECK(fetchBack(cache, keyOf(0, w, h), frames[0]), "frame reused from the compressed tier not hot");
+
+		// a second cache halves the share
+		{
+			RenderedFrameCache other;
+			CHECK(other.canStore(w, h), "a frame doesn't fit half the budget");
+			CHECK(!other.canStore(w, h * 2), "a double frame fits half the budget");
+
+			// the first cache comes down to its share on its next store
+			Frame frame = noisy(w, h, 4);
+			cache.store(keyOf(4, w, h), frame.bits.data(), frame.rowspan);
+			CHECK(fetchBack(cache, keyOf(4, w, h), frame), "last stored frame not fetched back");
+			CHECK(!fetchBack(cache, keyOf(2, w, h), frames[2]), "frame over the share fetched back");
+		}
+
+		CHECK(cache.canStore(w, h * 2), "share not back after the other cache went away");
+	}
+
+	// too large for the share, not kept
+	RenderedFrameCache::setBudget(frameBytes - 1, 0);
+	{
+		RenderedFrameCache cache;
+		CHECK(!cache.canStore(w, h), "a frame fits a smaller budget");
+
+		Frame frame = noisy(w, h, 5);
+		cache.store(keyOf(5, w, h), frame.bits.data(), frame.rowspan);
+		CHECK(!fetchBack(cache, keyOf(5, w, h), frame), "frame over budget fetched back");
+	}
+
+	if (failures)
+		printf("%d failures\n", failures);
+	else
+		printf("all passed\n");
+
+	return failures ? 1 : 0;
+}
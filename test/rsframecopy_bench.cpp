@@ -0,0 +1,90 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+// copyRows against memcpy per row on the frame copies of the renderer (readback, cache, staging), with and without
+// the workers. rsframecopy_bench [iterations]
+
+#include "rsframecopy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace ReaShader;
+
+struct Frame
+{
+	const char* name;
+	size_t w, h;
+	size_t padding; // of the video frame rows
+};
+
+static const Frame frames[] = {
+	{ "720p", 1280, 720, 0 },
+	{ "1080p", 1920, 1080, 0 },
+	{ "1080p strided", 1920, 1080, 64 },
+	{ "4K", 3840, 2160, 0 },
+	{ "4K strided", 3840, 2160, 64 },
+};
+
+template <typename F> static double measure(int iterations, F&& copy)
+{
+	copy(); // warm up, page faults
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		copy();
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+	return elapsed.count() / iterations;
+}
+
+static void bench(const Frame& frame, int iterations)
+{
+	size_t rowBytes = frame.w * 4;
+	size_t dstRowspan = rowBytes + frame.padding;
+	uint32_t rows = static_cast<uint32_t>(frame.h);
+
+	// tightly packed like the staging and readback buffers, the video frame is strided
+	std::vector<uint8_t> src(rowBytes * rows, 0x5a);
+	std::vector<uint8_t> dst(dstRowspan * rows);
+
+	double memcpyMs = measure(iterations, [&]() {
+		for (uint32_t row = 0; row < rows; row++)
+			memcpy(dst.data() + row * dstRowspan, src.data() + row * rowBytes, rowBytes);
+	});
+
+	double aloneMs = measure(iterations, [&]() {
+		copyRows(dst.data(), dstRowspan, src.data(), rowBytes, rowBytes, rows);
+	});
+
+	acquireCopyWorkers();
+	double workersMs = measure(iterations, [&]() {
+		copyRows(dst.data(), dstRowspan, src.data(), rowBytes, rowBytes, rows);
+	});
+	releaseCopyWorkers();
+
+	double gb = double(rowBytes * rows) / (1 << 30);
+
+	printf("%-14s  memcpy %7.3f ms %6.2f GB/s   copyRows %7.3f ms %6.2f GB/s   workers %7.3f ms %6.2f GB/s\n",
+		   frame.name, memcpyMs, gb / memcpyMs * 1000, aloneMs, gb / aloneMs * 1000, workersMs,
+		   gb / workersMs * 1000);
+}
+
+int main(int argc, char** argv)
+{
+	int iterations = argc > 1 ? std::max(atoi(argv[1]), 1) : 100;
+
+	for (const Frame& frame : frames)
+		bench(frame, iterations);
+
+	return 0;
+}
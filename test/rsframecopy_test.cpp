@@ -0,0 +1,158 @@
+/******************************************************************************
+ * Copyright (c) Emanuele Messina (https://github.com/emanuelemessina)
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ * See the LICENSE file (https://github.com/emanuelemessina/ReaShader/blob/main/LICENSE) for more information.
+ *****************************************************************************/
+
+// copyRows against a plain per byte reference, on small copies (cached stores), large ones (streaming stores split in
+// bands across the workers) and with the workers busy
+
+#include "rsframecopy.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace ReaShader;
+
+// the concurrent copies check from their threads
+static std::atomic<int> failures{ 0 };
+
+#define CHECK(condition, ...)                                                                                          \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		if (!(condition))                                                                                              \
+		{                                                                                                              \
+			failures++;                                                                                                \
+			printf("FAILED %s:%d: ", __FILE__, __LINE__);                                                              \
+			printf(__VA_ARGS__);                                                                                       \
+			printf("\n");                                                                                              \
+		}                                                                                                              \
+	} while (0)
+
+// guard bytes around and between the rows, copyRows must not touch them
+static constexpr uint8_t guard = 0xcd;
+
+struct Case
+{
+	const char* name;
+	size_t rowBytes;
+	uint32_t rows;
+	size_t dstPadding, srcPadding; // rowspan - rowBytes
+	size_t dstOffset, srcOffset;   // from a 64 byte aligned address
+};
+
+static void reference(uint8_t* dst, size_t dstRowspan, const uint8_t* src, size_t srcRowspan, size_t rowBytes,
+					  uint32_t rows)
+{
+	for (uint32_t row = 0; row < rows; row++)
+		for (size_t i = 0; i < rowBytes; i++)
+			dst[row * dstRowspan + i] = src[row * srcRowspan + i];
+}
+
+static uint8_t* align64(uint8_t* p)
+{
+	return (uint8_t*)(((uintptr_t)p + 63) & ~(uintptr_t)63);
+}
+
+static void run(const Case& c)
+{
+	size_t dstRowspan = c.rowBytes + c.dstPadding;
+	size_t srcRowspan = c.rowBytes + c.srcPadding;
+
+	std::vector<uint8_t> srcStorage(srcRowspan * c.rows + 128);
+	std::vector<uint8_t> dstStorage(dstRowspan * c.rows + 128, guard);
+	std::vector<uint8_t> expectedStorage(dstStorage.size(), guard);
+
+	uint8_t* src = align64(srcStorage.data()) + c.srcOffset;
+	size_t dstStart = (align64(dstStorage.data()) - dstStorage.data()) + c.dstOffset;
+
+	// not a multiple of any band or vector size, so misplaced bytes show
+	for (size_t i = 0; i < srcStorage.size(); i++)
+		srcStorage[i] = (uint8_t)(i * 131 + (i >> 11));
+
+	copyRows(dstStorage.data() + dstStart, dstRowspan, src, srcRowspan, c.rowBytes, c.rows);
+	reference(expectedStorage.data() + dstStart, dstRowspan, src, srcRowspan, c.rowBytes, c.rows);
+
+	for (size_t i = 0; i < dstStorage.size(); i++)
+		if (dstStorage[i] != expectedStorage[i])
+		{
+			CHECK(false, "%s: byte %zu (row %zu) is %u, expected %u", c.name, i, (i - dstStart) / dstRowspan,
+				  dstStorage[i], expectedStorage[i]);
+			break;
+		}
+}
+
+// 4K rgba rows, large enough for the streaming stores and the band split
+static constexpr size_t row4K = 3840 * 4;
+
+static const Case cases[] = {
+	// small, one memcpy per row or one for all
+	{ "packed small", 64 * 4, 64, 0, 0, 0, 0 },
+	{ "strided small", 64 * 4, 64, 32, 16, 0, 0 },
+	{ "strided small odd rows", 61 * 4 + 3, 37, 7, 5, 3, 1 },
+
+	// large packed (one long row), dst unaligned for the stream head
+	{ "packed large", row4K, 2160, 0, 0, 0, 0 },
+	{ "packed large unaligned dst", row4K, 2160, 0, 0, 7, 0 },
+	{ "packed large unaligned both", row4K, 2160, 0, 0, 13, 5 },
+
+	// large strided (video frame rows), the rowspan not a multiple of 16 misaligns every row differently
+	{ "strided large", row4K, 2160, 64, 0, 0, 0 },
+	{ "strided large unaligned dst", row4K, 2160, 64, 0, 1, 0 },
+	{ "strided large odd rowspan", row4K, 2160, 3, 9, 0, 0 },
+	{ "strided large odd row bytes", row4K - 5, 2160, 5, 0, 15, 3 },
+
+	// rows not a multiple of the band count, and a band of the last few rows
+	{ "bands uneven rows", row4K, 2161, 16, 0, 0, 0 },
+	{ "bands few rows", row4K * 128, 5, 0, 0, 4, 0 },
+	{ "bands odd row bytes", 1234567, 7, 1, 2, 9, 0 },
+};
+
+int main()
+{
+	// calling thread alone
+	for (const Case& c : cases)
+		run(c);
+
+	// split in bands across the workers, as many as the copies can take whatever the cores
+	acquireCopyWorkers(4);
+
+	for (const Case& c : cases)
+		run(c);
+
+	// concurrent copies, one of them finds the workers busy and copies alone
+	{
+		std::vector<std::thread> threads;
+		for (int i = 0; i < 4; i++)
+			threads.emplace_back([]() {
+				for (int repeat = 0; repeat < 4; repeat++)
+					run(cases[3 + repeat]);
+			});
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	releaseCopyWorkers();
+
+	// zero sized copies write nothing
+	{
+		uint8_t dst[16];
+		memset(dst, guard, sizeof(dst));
+		uint8_t src[16]{};
+		copyRows(dst, 16, src, 16, 0, 1);
+		copyRows(dst, 16, src, 16, 16, 0);
+		CHECK(dst[0] == guard && dst[15] == guard, "zero sized copy wrote");
+	}
+
+	if (failures)
+		printf("%d failures\n", failures.load());
+	else
+		printf("all passed\n");
+
+	return failures ? 1 : 0;
+}